@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Ezurio
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+"""Run a throughput scenario on two boards and compare the results with a baseline.
+
+Both boards run the sample; the harness drives their shells over serial ports
+(or native_sim PTYs), runs every case of the scenario on the central with
+'config output json' and collects the JSON record that ends each run.
+The scenario defaults are applied before every case, so a case only lists
+the settings that differ from them.
+
+    bench.py --central /dev/ttyACM0 --peripheral /dev/ttyACM2 \\
+        --scenario scenarios/nightly.json --baseline nightly_baseline.json
+
+Without --baseline the results are only printed (and saved with --results).
+--update-baseline writes the results as the new baseline.
+Exit status is 1 if a case failed or regressed, 0 otherwise.
+
+Requires pyserial.
+"""
+
+import argparse
+import json
+import re
+import sys
+import time
+
+import serial
+
+PROMPT = "uart:~$ "
+ANSI = re.compile(r"\x1b\[[0-9;?]*[A-Za-z]")
+READY = re.compile(r"Link \d+ ready")
+
+
+class Shell:
+    """Zephyr shell on a serial port or PTY."""
+
+    def __init__(self, name, port, baud, log):
+        self.name = name
+        self.log = log
+        self.port = serial.serial_for_url(port, baudrate=baud, timeout=0.1)
+        self.pending = ""
+
+    def close(self):
+        self.port.close()
+
+    def lines(self, timeout):
+        """Yield complete output lines until timeout (seconds) elapses."""
+        end = time.monotonic() + timeout
+        while time.monotonic() < end:
+            data = self.port.read(4096)
+            if not data:
+                continue
+            self.pending += ANSI.sub("", data.decode(errors="replace")).replace("\r", "")
+            while "\n" in self.pending:
+                line, self.pending = self.pending.split("\n", 1)
+                if self.log:
+                    self.log.write(f"{self.name}: {line}\n")
+                yield line
+
+    def cmd(self, command, timeout=5.0):
+        """Send a command and return its output up to the next prompt."""
+        self.port.reset_input_buffer()
+        self.pending = ""
+        self.port.write(f"{command}\r\n".encode())
+        out = []
+        end = time.monotonic() + timeout
+        while time.monotonic() < end:
+            for line in self.lines(0.2):
+                out.append(line)
+            if self.pending.endswith(PROMPT):
+                break
+        return out
+
+    def wait_for(self, pattern, timeout):
+        """Return the first line matching pattern, None on timeout."""
+        regex = re.compile(pattern)
+        for line in self.lines(timeout):
+            if regex.search(line):
+                return line
+        return None
+
+
+def run_case(central, case, defaults, timeout):
+    """Configure the central, run and return the JSON record.
+
+    The defaults are applied first, so no case depends on the cases before it.
+    """
+    for command in defaults + case.get("config", []):
+        central.cmd(command)
+
+    central.port.write(f"{case.get('run', 'run')}\r\n".encode())
+    for line in central.lines(case.get("timeout", timeout)):
+        line = line.strip()
+        if line.startswith("{") and '"kbps"' in line:
+            return json.loads(line)
+        if "Device is disconnected" in line or "not ready" in line or "Run failed" in line:
+            raise RuntimeError(line)
+    raise TimeoutError("no result record")
+
+
+def compare(result, baseline, checks):
+    """Return the list of regressions of result against baseline."""
+    failures = []
+    for metric, check in checks.items():
+        value = result.get(metric)
+        base = baseline.get(metric)
+        if value is None or base is None:
+            continue
+        margin = abs(base) * check.get("tolerance", 0.0) + check.get("slack", 0)
+        if check.get("better", "higher") == "higher":
+            bad = value < base - margin
+        else:
+            bad = value > base + margin
+        if bad:
+            failures.append(f"{metric} {value} vs baseline {base} (margin {margin:g})")
+    return failures
+
+
+def connect(central, peripheral, scenario):
+    for command in scenario.get("setup", {}).get("peripheral", ["peripheral"]):
+        peripheral.cmd(command)
+    for command in scenario.get("setup", {}).get("central", ["central"]):
+        central.cmd(command)
+
+    if not central.wait_for(READY.pattern, scenario.get("connect_timeout", 30)):
+        raise TimeoutError("boards did not connect")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--central", required=True, help="central serial port or PTY")
+    parser.add_argument("--peripheral", required=True, help="peripheral serial port or PTY")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--scenario", required=True, help="scenario file (JSON)")
+    parser.add_argument("--baseline", help="baseline file to compare with (JSON)")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="write the results to --baseline instead of comparing")
+    parser.add_argument("--results", help="write the results to this file (JSON)")
+    parser.add_argument("--log", help="write the console output of both boards here")
+    args = parser.parse_args()
+
+    with open(args.scenario) as f:
+        scenario = json.load(f)
+
+    log = open(args.log, "w") if args.log else None
+    central = Shell("central", args.central, args.baud, log)
+    peripheral = Shell("peripheral", args.peripheral, args.baud, log)
+
+    results = {}
+    failed = False
+
+    try:
+        for shell in (central, peripheral):
+            shell.cmd("shell colors off")
+        connect(central, peripheral, scenario)
+
+        defaults = scenario.get("defaults", []) + ["config output json"]
+
+        for case in scenario["cases"]:
+            name = case["name"]
+            try:
+                results[name] = run_case(central, case, defaults,
+                                         scenario.get("run_timeout", 60))
+                print(f"{name}: {results[name]['kbps']} kbps")
+            except (RuntimeError, TimeoutError, ValueError) as err:
+                print(f"{name}: FAILED ({err})")
+                failed = True
+    finally:
+        central.close()
+        peripheral.close()
+        if log:
+            log.close()
+
+    if args.results:
+        with open(args.results, "w") as f:
+            json.dump(results, f, indent=2)
+
+    if args.baseline and args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(results, f, indent=2)
+    elif args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        checks = scenario.get("checks", {"kbps": {"tolerance": 0.05}})
+        for name, result in results.items():
+            if name not in baseline:
+                print(f"{name}: no baseline")
+                continue
+            for failure in compare(result, baseline[name], checks):
+                print(f"{name}: REGRESSION {failure}")
+                failed = True
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "adapt.h"
+#include "sdc_vs.h"
+
+#define ADAPT_DEPTH_PERIOD K_MSEC(10)
+/* A new interval must beat the best rate by this much (percent) */
+#define ADAPT_GAIN_MIN	   5
+/* Explore again when the rate drops this much (percent) below the best rate */
+#define ADAPT_DROP	   20
+#define ADAPT_TIMEOUT	   400
+
+/* 1.25 ms units, 7.5 ms to 400 ms */
+static const uint16_t intervals[] = { 6, 8, 12, 16, 24, 32, 40, 80, 160, 320 };
+
+enum adapt_state {
+	/* Measure the current interval */
+	ADAPT_MEASURE,
+	/* Skip the period in which the interval changes */
+	ADAPT_SETTLE,
+	/* Measure the interval under test */
+	ADAPT_PROBE,
+	/* Keep the best interval */
+	ADAPT_HOLD,
+};
+
+static struct {
+	struct bt_conn *conn;
+	struct tx_window *win;
+	enum adapt_state state;
+	uint32_t last_acked;
+	uint32_t best_kbps;
+	uint8_t best;
+	uint8_t idx;
+	int8_t step;
+	/* Both directions have been probed from the best interval */
+	bool reversed;
+	/* Connection event extension enabled by adapt_start() */
+	bool extended;
+	/* Window depth, sampled by the depth timer */
+	atomic_t depth_sum;
+	atomic_t depth_count;
+} adapt;
+
+static void adapt_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(adapt_work, adapt_work_handler);
+
+static void depth_timer_expiry(struct k_timer *timer)
+{
+	atomic_add(&adapt.depth_sum, tx_window_in_flight(adapt.win));
+	atomic_inc(&adapt.depth_count);
+}
+
+static K_TIMER_DEFINE(depth_timer, depth_timer_expiry, NULL);
+
+static uint8_t nearest_interval(uint16_t interval)
+{
+	uint8_t idx = 0;
+
+	for (uint8_t i = 0; i < ARRAY_SIZE(intervals); i++) {
+		if (abs(intervals[i] - interval) < abs(intervals[idx] - interval)) {
+			idx = i;
+		}
+	}
+
+	return idx;
+}
+
+static int interval_set(uint8_t idx)
+{
+	const struct bt_le_conn_param param =
+		BT_LE_CONN_PARAM_INIT(intervals[idx], intervals[idx], 0, ADAPT_TIMEOUT);
+	int err;
+
+	err = bt_conn_le_param_update(adapt.conn, &param);
+	if (err) {
+		printk("[adapt] interval update failed (err %d)\n", err);
+		return err;
+	}
+
+	adapt.idx = idx;
+
+	return 0;
+}
+
+/* Try the next interval in the current direction; false when there is none left. */
+static bool probe_next(void)
+{
+	int next = adapt.best + adapt.step;
+
+	if (next < 0 || next >= (int)ARRAY_SIZE(intervals)) {
+		if (adapt.reversed) {
+			return false;
+		}
+
+		adapt.reversed = true;
+		adapt.step = -adapt.step;
+		next = adapt.best + adapt.step;
+		if (next < 0 || next >= (int)ARRAY_SIZE(intervals)) {
+			return false;
+		}
+	}
+
+	if (interval_set(next)) {
+		return false;
+	}
+
+	adapt.state = ADAPT_SETTLE;
+
+	return true;
+}
+
+static void hold_best(void)
+{
+	if (adapt.idx != adapt.best) {
+		interval_set(adapt.best);
+	}
+
+	adapt.state = ADAPT_HOLD;
+}
+
+static void adapt_work_handler(struct k_work *work)
+{
+	uint32_t acked = atomic_get(&adapt.win->acked);
+	uint32_t count = atomic_clear(&adapt.depth_count);
+	uint32_t depth = count ? atomic_clear(&adapt.depth_sum) / count : 0;
+	uint32_t kbps = (acked - adapt.last_acked) * 8 / CONFIG_BT_THROUGHPUT_ADAPT_PERIOD;
+	bool link_limited = depth * 4 >= adapt.win->size * 3;
+	uint16_t interval = intervals[adapt.idx];
+
+	adapt.last_acked = acked;
+
+	printk("[adapt] interval %u.%02u ms: %u kbps, window %u of %u\n", interval * 5 / 4,
+	       (interval * 125) % 100, kbps, depth, adapt.win->size);
+
+	switch (adapt.state) {
+	case ADAPT_MEASURE:
+		adapt.best_kbps = kbps;
+		adapt.best = adapt.idx;
+		adapt.reversed = false;
+		if (link_limited && !probe_next()) {
+			adapt.state = ADAPT_HOLD;
+		}
+		break;
+
+	case ADAPT_SETTLE:
+		adapt.state = adapt.best_kbps ? ADAPT_PROBE : ADAPT_MEASURE;
+		break;
+
+	case ADAPT_PROBE:
+		if (kbps * 100 > adapt.best_kbps * (100 + ADAPT_GAIN_MIN)) {
+			/* Keep going in the same direction */
+			adapt.best_kbps = kbps;
+			adapt.best = adapt.idx;
+			if (!probe_next()) {
+				adapt.state = ADAPT_HOLD;
+			}
+		} else if (!adapt.reversed) {
+			adapt.reversed = true;
+			adapt.step = -adapt.step;
+			if (!probe_next()) {
+				hold_best();
+			}
+		} else {
+			hold_best();
+		}
+		break;
+
+	case ADAPT_HOLD:
+		/* RF conditions changed; search again from here. */
+		if (kbps * 100 < adapt.best_kbps * (100 - ADAPT_DROP)) {
+			adapt.state = ADAPT_MEASURE;
+		}
+		break;
+	}
+
+	k_work_reschedule(&adapt_work, K_MSEC(CONFIG_BT_THROUGHPUT_ADAPT_PERIOD));
+}
+
+void adapt_start(struct bt_conn *conn, struct tx_window *win)
+{
+	struct bt_conn_info info = {0};
+	int err;
+
+	if (bt_conn_get_info(conn, &info)) {
+		return;
+	}
+
+	err = sdc_vs_conn_event_extend(true);
+	if (err) {
+		printk("[adapt] connection event extension not available (err %d)\n", err);
+	}
+	adapt.extended = !err;
+
+	adapt.conn = conn;
+	adapt.win = win;
+	adapt.state = ADAPT_MEASURE;
+	adapt.idx = nearest_interval(info.le.interval);
+	adapt.best = adapt.idx;
+	adapt.best_kbps = 0;
+	/* Shorter intervals first; they recover sooner from lost packets. */
+	adapt.step = -1;
+	adapt.last_acked = atomic_get(&win->acked);
+	atomic_clear(&adapt.depth_sum);
+	atomic_clear(&adapt.depth_count);
+
+	/* Start from an interval of the table. */
+	if (intervals[adapt.idx] != info.le.interval) {
+		interval_set(adapt.idx);
+		adapt.state = ADAPT_SETTLE;
+	}
+
+	k_timer_start(&depth_timer, ADAPT_DEPTH_PERIOD, ADAPT_DEPTH_PERIOD);
+	k_work_reschedule(&adapt_work, K_MSEC(CONFIG_BT_THROUGHPUT_ADAPT_PERIOD));
+}
+
+uint16_t adapt_stop(void)
+{
+	struct k_work_sync sync;
+
+	k_timer_stop(&depth_timer);
+	k_work_cancel_delayable_sync(&adapt_work, &sync);
+
+	if (adapt.extended) {
+		adapt.extended = false;
+		sdc_vs_conn_event_extend(false);
+	}
+
+	if (!adapt.conn) {
+		return 0;
+	}
+
+	adapt.conn = NULL;
+
+	return adapt.best_kbps ? intervals[adapt.best] : 0;
+}
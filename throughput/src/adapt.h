@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_ADAPT_H_
+#define THROUGHPUT_ADAPT_H_
+
+#include <zephyr/bluetooth/conn.h>
+
+#include "tx_engine.h"
+
+/**
+ * @brief Tune the connection interval while a run is in progress.
+ * Every CONFIG_BT_THROUGHPUT_ADAPT_PERIOD ms the rate of the window is compared with
+ * the best rate so far and the interval is moved one step toward the better rate.
+ * The interval is only changed while the window is mostly full (link limited).
+ * Connection event extension is enabled for the run so events fill the interval.
+ *
+ * @param conn Connection (central).
+ * @param win  Window of the run.
+ */
+void adapt_start(struct bt_conn *conn, struct tx_window *win);
+
+/**
+ * @brief Stop tuning. The connection keeps the best interval found.
+ *
+ * @return Best interval (1.25 ms units), 0 if nothing was measured.
+ */
+uint16_t adapt_stop(void);
+
+#endif /* THROUGHPUT_ADAPT_H_ */
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/shell/shell.h>
+
+#if defined(CONFIG_SHELL_BACKEND_DUMMY)
+#include <zephyr/shell/shell_dummy.h>
+#else
+#include <zephyr/shell/shell_uart.h>
+#endif
+
+#if defined(CONFIG_ARCH_POSIX)
+#include <posix_board_if.h>
+#endif
+
+#include "main.h"
+#include "autorun.h"
+
+#define AUTORUN_STACK_SIZE    2048
+#define AUTORUN_PRIORITY      K_PRIO_PREEMPT(7)
+#define AUTORUN_READY_TIMEOUT K_SECONDS(30)
+#define AUTORUN_POLL	      K_MSEC(500)
+
+static K_THREAD_STACK_DEFINE(autorun_stack, AUTORUN_STACK_SIZE);
+static struct k_thread autorun_thread_data;
+static K_SEM_DEFINE(autorun_disconnected, 0, 1);
+static struct bt_conn *autorun_conn;
+
+static void connected(struct bt_conn *conn, uint8_t hci_err)
+{
+	if (!hci_err && !autorun_conn) {
+		autorun_conn = bt_conn_ref(conn);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	if (conn == autorun_conn) {
+		bt_conn_unref(autorun_conn);
+		autorun_conn = NULL;
+		k_sem_give(&autorun_disconnected);
+	}
+}
+
+BT_CONN_CB_DEFINE(autorun_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+static const struct shell *autorun_shell(void)
+{
+#if defined(CONFIG_SHELL_BACKEND_DUMMY)
+	return shell_backend_dummy_get_ptr();
+#else
+	return shell_backend_uart_get_ptr();
+#endif
+}
+
+static void autorun_exit(int status)
+{
+	printk("Autorun %s\n", status ? "FAIL" : "PASS");
+
+#if defined(CONFIG_ARCH_POSIX)
+	posix_exit(status);
+#endif
+}
+
+static int central_run(void)
+{
+	const struct bt_le_conn_param conn_param = BT_LE_CONN_PARAM_INIT(
+		CONFIG_BT_THROUGHPUT_AUTORUN_CONN_INTERVAL,
+		CONFIG_BT_THROUGHPUT_AUTORUN_CONN_INTERVAL, 0, 400);
+	const struct bt_conn_le_phy_param phy = {
+		.options = BT_CONN_LE_PHY_OPT_NONE,
+		.pref_tx_phy = BT_GAP_LE_PHY_2M,
+		.pref_rx_phy = BT_GAP_LE_PHY_2M,
+	};
+	const struct bt_conn_le_data_len_param data_len = {
+		.tx_max_len = BT_GAP_DATA_LEN_MAX,
+		.tx_max_time = BT_GAP_DATA_TIME_MAX,
+	};
+	k_timepoint_t end = sys_timepoint_calc(AUTORUN_READY_TIMEOUT);
+	struct test_result res;
+	uint64_t kbps;
+	int err;
+
+	/* The link is ready after discovery and MTU exchange. */
+	do {
+		k_sleep(AUTORUN_POLL);
+		err = test_sweep_point(autorun_shell(), &conn_param, &phy, &data_len,
+				       CONFIG_BT_L2CAP_TX_MTU, CONFIG_BT_THROUGHPUT_DURATION, &res);
+	} while (err == -EPERM && !sys_timepoint_expired(end));
+
+	if (err) {
+		printk("Autorun test failed (err %d)\n", err);
+		return err;
+	}
+
+	kbps = (uint64_t)res.bytes * 8 * 1000 / MAX(1, res.us);
+	printk("Autorun sent %u bytes in %llu us at %llu kbps (minimum %u kbps)\n", res.bytes,
+	       res.us, kbps, CONFIG_BT_THROUGHPUT_AUTORUN_MIN_KBPS);
+
+	return (kbps < CONFIG_BT_THROUGHPUT_AUTORUN_MIN_KBPS) ? -EIO : 0;
+}
+
+static void autorun_thread(void *p1, void *p2, void *p3)
+{
+	int err;
+
+	if (!IS_ENABLED(CONFIG_BT_THROUGHPUT_AUTORUN_CENTRAL)) {
+		/* The tester disconnects when it is done. */
+		k_sem_take(&autorun_disconnected, K_FOREVER);
+		autorun_exit(0);
+		return;
+	}
+
+	err = central_run();
+
+	if (autorun_conn) {
+		bt_conn_disconnect(autorun_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		k_sem_take(&autorun_disconnected, K_SECONDS(5));
+	}
+
+	autorun_exit(err ? 1 : 0);
+}
+
+void autorun_start(void)
+{
+	select_role(IS_ENABLED(CONFIG_BT_THROUGHPUT_AUTORUN_CENTRAL), NULL);
+
+	k_thread_create(&autorun_thread_data, autorun_stack, K_THREAD_STACK_SIZEOF(autorun_stack),
+			autorun_thread, NULL, NULL, NULL, AUTORUN_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&autorun_thread_data, "autorun");
+}
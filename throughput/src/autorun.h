@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_AUTORUN_H_
+#define THROUGHPUT_AUTORUN_H_
+
+/**
+ * @brief Select the configured role and run the test without shell input.
+ * The central checks the rate against CONFIG_BT_THROUGHPUT_AUTORUN_MIN_KBPS;
+ * on simulated boards both devices exit with the result.
+ */
+void autorun_start(void);
+
+#endif /* THROUGHPUT_AUTORUN_H_ */
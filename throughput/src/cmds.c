@@ -5,7 +5,9 @@
  * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zephyr/bluetooth/conn.h>
 
@@ -14,6 +16,14 @@
 #include <zephyr/types.h>
 
 #include "main.h"
+#include "sampler.h"
+#include "rssi.h"
+#include "source.h"
+#include "conn_stats.h"
+#include "timeline.h"
+#include "gatt_cache.h"
+#include "reconnect.h"
+#include "range.h"
 
 #define INTERVAL_MIN 0x140 /* 320 units, 400 ms */
 #define INTERVAL_MAX 0x140 /* 320 units, 400 ms */
@@ -28,12 +38,21 @@ static struct test_params {
 	struct bt_conn_le_phy_param *phy;
 	bool phy_request;
 	struct bt_conn_le_data_len_param *data_len;
+	enum transport transport;
+	enum direction direction;
+	bool adaptive;
+	bool verify;
+	enum output_format output;
+	uint16_t mtu;
+	uint16_t write_size;
 } test_params = {
 	.conn_param = BT_LE_CONN_PARAM(INTERVAL_MIN, INTERVAL_MAX, CONN_LATENCY,
 				       SUPERVISION_TIMEOUT),
 	.phy = BT_CONN_LE_PHY_PARAM_2M,
 	.phy_request = false,
-	.data_len = BT_LE_DATA_LEN_PARAM_MAX
+	.data_len = BT_LE_DATA_LEN_PARAM_MAX,
+	.transport = TRANSPORT_GATT,
+	.direction = DIRECTION_UPLINK
 };
 
 static const char *phy_str(const struct bt_conn_le_phy_param *phy)
@@ -220,16 +239,264 @@ static int conn_interval_cmd(const struct shell *shell, size_t argc,
 	return 0;
 }
 
+/* Parse a 0..UINT16_MAX argument; 0 selects the automatic value. */
+static int u16_arg(const struct shell *shell, size_t argc, char **argv, uint16_t *val)
+{
+	char *end;
+	unsigned long v;
+
+	if (argc == 1) {
+		shell_help(shell);
+		return SHELL_CMD_HELP_PRINTED;
+	}
+
+	if (argc > 2) {
+		shell_error(shell, "%s: bad parameters count", argv[0]);
+		return -EINVAL;
+	}
+
+	v = strtoul(argv[1], &end, 10);
+	if (*end != '\0' || v > UINT16_MAX) {
+		shell_error(shell, "%s: Invalid setting: %s", argv[0], argv[1]);
+		return -EINVAL;
+	}
+
+	*val = v;
+
+	return 0;
+}
+
+static int mtu_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	uint16_t mtu;
+	int err;
+
+	err = u16_arg(shell, argc, argv, &mtu);
+	if (err) {
+		return err;
+	}
+
+	err = select_mtu(shell, mtu);
+	if (!err) {
+		test_params.mtu = mtu;
+	}
+
+	return err;
+}
+
+static int write_size_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	uint16_t size;
+	int err;
+
+	err = u16_arg(shell, argc, argv, &size);
+	if (err) {
+		return err;
+	}
+
+	err = select_write_size(shell, size);
+	if (!err) {
+		test_params.write_size = size;
+	}
+
+	return err;
+}
+
+static int cmd_transport_gatt(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.transport = TRANSPORT_GATT;
+	select_transport(shell, test_params.transport);
+
+	return 0;
+}
+
+static int cmd_transport_l2cap(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.transport = TRANSPORT_L2CAP;
+	select_transport(shell, test_params.transport);
+
+	return 0;
+}
+
+static int cmd_direction_uplink(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.direction = DIRECTION_UPLINK;
+	select_direction(shell, test_params.direction);
+
+	return 0;
+}
+
+static int cmd_direction_duplex(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.direction = DIRECTION_DUPLEX;
+	select_direction(shell, test_params.direction);
+
+	return 0;
+}
+
+static int cmd_sched_rr(const struct shell *shell, size_t argc, char **argv)
+{
+	select_sched_policy(shell, SCHED_ROUND_ROBIN);
+
+	return 0;
+}
+
+static int cmd_sched_weighted(const struct shell *shell, size_t argc, char **argv)
+{
+	select_sched_policy(shell, SCHED_WEIGHTED);
+
+	return 0;
+}
+
+static int source_select_cmd(const struct shell *shell, enum source_type type)
+{
+	int err = source_select(type);
+
+	if (err == -ENOTSUP) {
+		shell_error(shell, "No storage partition on this board");
+	} else if (err == -ENODATA) {
+		shell_error(shell, "Load data with 'source load' first");
+	} else if (err) {
+		shell_error(shell, "Source %s not available (err %d)", source_name(type), err);
+	} else {
+		shell_print(shell, "Data source: %s", source_name(type));
+	}
+
+	return err;
+}
+
+static int cmd_source_pattern(const struct shell *shell, size_t argc, char **argv)
+{
+	return source_select_cmd(shell, SOURCE_PATTERN);
+}
+
+static int cmd_source_flash(const struct shell *shell, size_t argc, char **argv)
+{
+	return source_select_cmd(shell, SOURCE_FLASH);
+}
+
+static int cmd_source_buffer(const struct shell *shell, size_t argc, char **argv)
+{
+	return source_select_cmd(shell, SOURCE_BUFFER);
+}
+
+static int cmd_verify_on(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.verify = true;
+	select_verify(shell, true);
+
+	return 0;
+}
+
+static int cmd_verify_off(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.verify = false;
+	select_verify(shell, false);
+
+	return 0;
+}
+
+static int cmd_adaptive_on(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.adaptive = true;
+	select_adaptive(shell, true);
+
+	return 0;
+}
+
+static int cmd_adaptive_off(const struct shell *shell, size_t argc, char **argv)
+{
+	test_params.adaptive = false;
+	select_adaptive(shell, false);
+
+	return 0;
+}
+
+static int output_select_cmd(const struct shell *shell, enum output_format format)
+{
+	test_params.output = format;
+	select_output_format(shell, format);
+
+	return 0;
+}
+
+static int cmd_output_text(const struct shell *shell, size_t argc, char **argv)
+{
+	return output_select_cmd(shell, OUTPUT_TEXT);
+}
+
+static int cmd_output_json(const struct shell *shell, size_t argc, char **argv)
+{
+	return output_select_cmd(shell, OUTPUT_JSON);
+}
+
+static int cmd_output_csv(const struct shell *shell, size_t argc, char **argv)
+{
+	return output_select_cmd(shell, OUTPUT_CSV);
+}
+
+static int reconnect_select_cmd(const struct shell *shell, enum reconnect_mode mode)
+{
+	reconnect_mode_set(mode);
+	shell_print(shell, "Reconnect: %s", mode == RECONNECT_FAST ? "fast" : "normal");
+
+	return 0;
+}
+
+static int cmd_reconnect_normal(const struct shell *shell, size_t argc, char **argv)
+{
+	return reconnect_select_cmd(shell, RECONNECT_NORMAL);
+}
+
+static int cmd_reconnect_fast(const struct shell *shell, size_t argc, char **argv)
+{
+	return reconnect_select_cmd(shell, RECONNECT_FAST);
+}
+
+static int link_weight_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	if (argc == 1) {
+		shell_help(shell);
+		return SHELL_CMD_HELP_PRINTED;
+	}
+
+	if (argc != 3) {
+		shell_error(shell, "%s: bad parameters count", argv[0]);
+		return -EINVAL;
+	}
+
+	return set_link_weight(shell, strtoul(argv[1], NULL, 10),
+			       (uint8_t)strtoul(argv[2], NULL, 10));
+}
+
 static int print_cmd(const struct shell *shell, size_t argc,
 		     char **argv)
 {
 	shell_print(shell, "==== Current test configuration ====\n");
 	shell_print(shell, "Data length:\t\t%d\n"
 		    "Connection interval:\t%d units\n"
-		    "Preferred PHY:\t\t%s\n",
+		    "Preferred PHY:\t\t%s\n"
+		    "Transport:\t\t%s\n"
+		    "Direction:\t\t%s\n"
+		    "Adaptive interval:\t%s\n"
+		    "Verify data:\t\t%s\n"
+		    "Data source:\t\t%s\n"
+		    "ATT MTU:\t\t%u%s\n"
+		    "Write size:\t\t%u%s\n"
+		    "Result output:\t\t%s\n"
+		    "Reconnect:\t\t%s\n",
 		    test_params.data_len->tx_max_len,
 		    test_params.conn_param->interval_min,
-		    phy_str(test_params.phy));
+		    phy_str(test_params.phy),
+		    test_params.transport == TRANSPORT_L2CAP ? "L2CAP" : "GATT",
+		    test_params.direction == DIRECTION_DUPLEX ? "duplex" : "uplink",
+		    test_params.adaptive ? "on" : "off",
+		    test_params.verify ? "on" : "off",
+		    source_name(source_selected()),
+		    test_params.mtu, test_params.mtu ? "" : " (negotiated)",
+		    test_params.write_size, test_params.write_size ? "" : " (MTU - 3)",
+		    report_format_name(test_params.output),
+		    reconnect_mode_get() == RECONNECT_FAST ? "fast" : "normal");
 	return 0;
 }
 
@@ -267,12 +534,79 @@ SHELL_STATIC_SUBCMD_SET_CREATE(phy_sub,
 	SHELL_SUBCMD_SET_END
 );
 
+SHELL_STATIC_SUBCMD_SET_CREATE(transport_sub,
+	SHELL_CMD(gatt, NULL, "Send data with GATT write without response",
+		  cmd_transport_gatt),
+	SHELL_CMD(l2cap, NULL, "Send data on an L2CAP credit based channel",
+		  cmd_transport_l2cap),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(direction_sub,
+	SHELL_CMD(uplink, NULL, "Only the tester sends", cmd_direction_uplink),
+	SHELL_CMD(duplex, NULL, "Tester writes while the peer notifies",
+		  cmd_direction_duplex),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sched_sub,
+	SHELL_CMD(rr, NULL, "Serve links in turn", cmd_sched_rr),
+	SHELL_CMD(weighted, NULL, "Share the window by link weight", cmd_sched_weighted),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(adaptive_sub,
+	SHELL_CMD(on, NULL, "Tune the connection interval during the run", cmd_adaptive_on),
+	SHELL_CMD(off, NULL, "Keep the configured connection interval", cmd_adaptive_off),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(verify_sub,
+	SHELL_CMD(on, NULL, "Send sequence numbered packets with a CRC", cmd_verify_on),
+	SHELL_CMD(off, NULL, "Send the plain pattern", cmd_verify_off),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(source_sub,
+	SHELL_CMD(pattern, NULL, "Send the generated pattern", cmd_source_pattern),
+	SHELL_CMD(flash, NULL, "Send the storage partition", cmd_source_flash),
+	SHELL_CMD(buffer, NULL, "Send the data loaded with 'source load'", cmd_source_buffer),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(output_sub,
+	SHELL_CMD(text, NULL, "Only print the result text", cmd_output_text),
+	SHELL_CMD(json, NULL, "End each run with a JSON record", cmd_output_json),
+	SHELL_CMD(csv, NULL, "End each run with a CSV header and record", cmd_output_csv),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(reconnect_sub,
+	SHELL_CMD(normal, NULL, "Scan for any peer with the normal window", cmd_reconnect_normal),
+	SHELL_CMD(fast, NULL, "Scan for the lost peer only, continuously at first",
+		  cmd_reconnect_fast),
+	SHELL_SUBCMD_SET_END
+);
+
 SHELL_STATIC_SUBCMD_SET_CREATE(sub_config,
 	SHELL_CMD(data_length, NULL, "Configure data length", data_len_cmd),
 	SHELL_CMD(conn_interval, NULL,
 		  "Configure connection interval <1.25ms units>",
 		  conn_interval_cmd),
+	SHELL_CMD(mtu, NULL, "Configure ATT MTU <23..max>, 0 for the negotiated MTU", mtu_cmd),
+	SHELL_CMD(write_size, NULL, "Configure write size in bytes, 0 for MTU - 3",
+		  write_size_cmd),
 	SHELL_CMD(phy, &phy_sub, "Configure connection interval", default_cmd),
+	SHELL_CMD(transport, &transport_sub, "Configure transport", default_cmd),
+	SHELL_CMD(direction, &direction_sub, "Configure direction", default_cmd),
+	SHELL_CMD(source, &source_sub, "Configure data source", default_cmd),
+	SHELL_CMD(verify, &verify_sub, "Configure data verification", default_cmd),
+	SHELL_CMD(output, &output_sub, "Configure result output format", default_cmd),
+	SHELL_CMD(reconnect, &reconnect_sub, "Configure reconnect after link loss", default_cmd),
+	SHELL_CMD(adaptive, &adaptive_sub, "Configure adaptive interval", default_cmd),
+	SHELL_CMD(sched, &sched_sub, "Configure multi link scheduling", default_cmd),
+	SHELL_CMD(link_weight, NULL, "Configure link weight <link> <1..16>",
+		  link_weight_cmd),
 	SHELL_CMD(print, NULL, "Print current configuration", print_cmd),
 	SHELL_CMD(print_type, NULL, "Print type configuration\n"
 		  "0 - nothing, 1 - graphics, 2 - RSSI, ", print_type_cmd),
@@ -280,11 +614,552 @@ SHELL_STATIC_SUBCMD_SET_CREATE(sub_config,
 );
 
 
+/* Size in bytes with an optional K or M suffix (1024 based) */
+static int size_parse(const char *str, uint32_t *size)
+{
+	char *end;
+	uint64_t val = strtoull(str, &end, 10);
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		val *= 1024;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		val *= 1024 * 1024;
+		end++;
+		break;
+	default:
+		break;
+	}
+
+	if (*end != '\0' || val == 0 || val > UINT32_MAX) {
+		return -EINVAL;
+	}
+
+	*size = val;
+
+	return 0;
+}
+
 static int test_run_cmd(const struct shell *shell, size_t argc,
 			char **argv)
 {
+	uint32_t size = 0;
+
+	if (argc > 2) {
+		shell_error(shell, "%s: bad parameters count", argv[0]);
+		return -EINVAL;
+	}
+
+	if (argc == 2 && size_parse(argv[1], &size)) {
+		shell_error(shell, "%s: Invalid size: %s", argv[0], argv[1]);
+		return -EINVAL;
+	}
+
 	return test_run(shell, test_params.conn_param,
-			test_params.phy_request ? test_params.phy : NULL, test_params.data_len);
+			test_params.phy_request ? test_params.phy : NULL, test_params.data_len,
+			size);
+}
+
+#define SWEEP_DURATION_DEFAULT 2000
+
+static const struct bt_conn_le_phy_param sweep_phy[] = {
+	{ .options = BT_CONN_LE_PHY_OPT_NONE,
+	  .pref_tx_phy = BT_GAP_LE_PHY_1M, .pref_rx_phy = BT_GAP_LE_PHY_1M },
+	{ .options = BT_CONN_LE_PHY_OPT_NONE,
+	  .pref_tx_phy = BT_GAP_LE_PHY_2M, .pref_rx_phy = BT_GAP_LE_PHY_2M },
+#if defined(RADIO_MODE_MODE_Ble_LR125Kbit) || defined(NRF5340_XXAA_APPLICATION)
+	{ .options = BT_CONN_LE_PHY_OPT_CODED_S8,
+	  .pref_tx_phy = BT_GAP_LE_PHY_CODED, .pref_rx_phy = BT_GAP_LE_PHY_CODED },
+#endif
+};
+
+static const struct bt_conn_le_data_len_param sweep_data_len[] = {
+	{ .tx_max_len = BT_GAP_DATA_LEN_DEFAULT, .tx_max_time = BT_GAP_DATA_TIME_MAX },
+	{ .tx_max_len = BT_GAP_DATA_LEN_MAX, .tx_max_time = BT_GAP_DATA_TIME_MAX },
+};
+
+/* 1.25 ms units */
+static const uint16_t sweep_interval[] = { 6, 24, 80, 320 };
+
+static const uint16_t sweep_mtu[] = { 23, 247, CONFIG_BT_L2CAP_TX_MTU };
+
+#define SWEEP_POINTS                                                                     \
+	(ARRAY_SIZE(sweep_phy) * ARRAY_SIZE(sweep_data_len) * ARRAY_SIZE(sweep_interval) *   \
+	 ARRAY_SIZE(sweep_mtu))
+
+static struct sweep_point {
+	uint8_t phy;
+	uint8_t data_len;
+	uint8_t interval;
+	uint8_t mtu;
+	int err;
+	struct test_result res;
+} sweep_results[SWEEP_POINTS];
+
+static uint32_t sweep_kbps(const struct test_result *res)
+{
+	return res->us ? (uint32_t)((uint64_t)res->bytes * 8 * 1000 / res->us) : 0;
+}
+
+static void sweep_print(const struct shell *shell, size_t count)
+{
+	const struct sweep_point *best = NULL;
+	const struct sweep_point *p;
+	uint16_t interval;
+
+	shell_print(shell, "\n==== Sweep results ====");
+	shell_print(shell, "%-9s %4s %8s %4s %4s %6s %10s", "PHY", "DL", "Int(ms)", "MTU",
+		    "Len", "kbps", "p99 us");
+
+	for (size_t i = 0; i < count; i++) {
+		p = &sweep_results[i];
+		interval = sweep_interval[p->interval];
+
+		if (p->err) {
+			shell_print(shell, "%-9s %4u %5u.%02u %4u %4s  error %d",
+				    phy_str(&sweep_phy[p->phy]),
+				    sweep_data_len[p->data_len].tx_max_len,
+				    interval * 5 / 4, (interval * 125) % 100, sweep_mtu[p->mtu],
+				    "-", p->err);
+			continue;
+		}
+
+		shell_print(shell, "%-9s %4u %5u.%02u %4u %4u %6u %6u.%03u",
+			    phy_str(&sweep_phy[p->phy]), sweep_data_len[p->data_len].tx_max_len,
+			    interval * 5 / 4, (interval * 125) % 100, sweep_mtu[p->mtu],
+			    p->res.len, sweep_kbps(&p->res), p->res.submit_p99_ns / 1000,
+			    p->res.submit_p99_ns % 1000);
+
+		if (!best || sweep_kbps(&p->res) > sweep_kbps(&best->res)) {
+			best = p;
+		}
+	}
+
+	if (best) {
+		shell_print(shell, "Best: %s, data length %u, interval %u units, MTU %u: %u kbps",
+			    phy_str(&sweep_phy[best->phy]),
+			    sweep_data_len[best->data_len].tx_max_len,
+			    sweep_interval[best->interval], sweep_mtu[best->mtu],
+			    sweep_kbps(&best->res));
+	}
+}
+
+static int sweep_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	struct bt_le_conn_param conn_param = *test_params.conn_param;
+	uint32_t duration = SWEEP_DURATION_DEFAULT;
+	struct bt_conn_le_phy_param prev;
+	struct sweep_point *p;
+	size_t count = 0;
+
+	if (argc > 2) {
+		shell_error(shell, "%s: bad parameters count", argv[0]);
+		return -EINVAL;
+	}
+
+	if (argc == 2) {
+		duration = strtoul(argv[1], NULL, 10);
+		if (duration == 0) {
+			shell_error(shell, "%s: Invalid duration: %s", argv[0], argv[1]);
+			return -EINVAL;
+		}
+	}
+
+	if (test_phy_get(&prev)) {
+		shell_error(shell, "Connect as central and wait for the link to be ready");
+		return -EPERM;
+	}
+
+	shell_print(shell, "Sweeping %u points of %u ms", (unsigned int)SWEEP_POINTS, duration);
+
+	for (uint8_t phy = 0; phy < ARRAY_SIZE(sweep_phy); phy++) {
+		for (uint8_t dl = 0; dl < ARRAY_SIZE(sweep_data_len); dl++) {
+			for (uint8_t in = 0; in < ARRAY_SIZE(sweep_interval); in++) {
+				conn_param.interval_min = sweep_interval[in];
+				conn_param.interval_max = sweep_interval[in];
+
+				for (uint8_t mtu = 0; mtu < ARRAY_SIZE(sweep_mtu); mtu++) {
+					p = &sweep_results[count++];
+					p->phy = phy;
+					p->data_len = dl;
+					p->interval = in;
+					p->mtu = mtu;
+
+					shell_print(shell, "[%u/%u]", (unsigned int)count,
+						    (unsigned int)SWEEP_POINTS);
+					p->err = test_sweep_point(shell, &conn_param,
+								  &sweep_phy[phy],
+								  &sweep_data_len[dl],
+								  sweep_mtu[mtu], duration,
+								  &p->res);
+
+					/* Without a link or with an unsupported config,
+					 * the remaining points would fail too.
+					 */
+					if (p->err == -EPERM || p->err == -ENOTSUP) {
+						sweep_print(shell, count);
+						return p->err;
+					}
+				}
+			}
+		}
+	}
+
+	/* Leave the link on the PHY it had before the sweep. */
+	test_phy_set(shell, &prev);
+	sweep_print(shell, count);
+
+	return 0;
+}
+
+#define TXPWR_SWEEP_DURATION_DEFAULT 2000
+#define TXPWR_SWEEP_STEP_DEFAULT     2
+#define TXPWR_SWEEP_LEVELS	     64
+/* Levels reaching this share of the best rate saturate the link */
+#define TXPWR_SATURATION_PCT	     95
+
+static struct txpwr_point {
+	int8_t requested;
+	/* Level the controller selected (write response) */
+	int8_t selected;
+	/* Level read back from the controller */
+	int8_t reported;
+	bool reported_valid;
+	int err;
+	struct test_result res;
+} txpwr_results[TXPWR_SWEEP_LEVELS];
+
+/* Signed value or "-" in a column */
+static const char *opt_col(char *buf, size_t size, bool valid, int val)
+{
+	if (!valid) {
+		return "-";
+	}
+
+	snprintf(buf, size, "%d", val);
+
+	return buf;
+}
+
+static void txpwr_sweep_print(const struct shell *shell, size_t count)
+{
+	const struct txpwr_point *lowest = NULL;
+	const struct txpwr_point *p;
+	const struct test_result *r;
+	char level[8];
+	char rssi[8];
+	char peer[8];
+	char per[12];
+	uint32_t best = 0;
+	uint32_t lost;
+
+	shell_print(shell, "\n==== TX power sweep ====");
+	shell_print(shell, "%4s %4s %4s %6s %5s %5s %6s", "Req", "Sel", "Read", "kbps", "RSSI",
+		    "Peer", "PER %");
+
+	for (size_t i = 0; i < count; i++) {
+		p = &txpwr_results[i];
+		r = &p->res;
+
+		if (p->err) {
+			shell_print(shell, "%4d %4s %4s  error %d", p->requested, "-", "-", p->err);
+			continue;
+		}
+
+		best = MAX(best, sweep_kbps(r));
+
+		/* Packets not acknowledged by the peer, in 0.01 % */
+		if (r->events_valid && r->tx_packets) {
+			lost = r->tx_packets - MIN(r->tx_acked, r->tx_packets);
+			lost = (uint32_t)((uint64_t)lost * 10000 / r->tx_packets);
+			snprintf(per, sizeof(per), "%u.%02u", lost / 100, lost % 100);
+		} else {
+			strcpy(per, "-");
+		}
+
+		shell_print(shell, "%4d %4d %4s %6u %5s %5s %6s", p->requested, p->selected,
+			    opt_col(level, sizeof(level), p->reported_valid, p->reported),
+			    sweep_kbps(r),
+			    opt_col(rssi, sizeof(rssi), r->rssi_samples, r->rssi_avg),
+			    opt_col(peer, sizeof(peer), r->peer_rssi_valid, r->peer_rssi), per);
+	}
+
+	/* The lowest power that still saturates the link */
+	for (size_t i = 0; i < count; i++) {
+		p = &txpwr_results[i];
+
+		if (p->err || (uint64_t)sweep_kbps(&p->res) * 100 <
+			      (uint64_t)best * TXPWR_SATURATION_PCT) {
+			continue;
+		}
+
+		if (!lowest || p->selected < lowest->selected) {
+			lowest = p;
+		}
+	}
+
+	if (lowest) {
+		shell_print(shell, "Lowest level within %u %% of the best rate (%u kbps): %d dBm, "
+			    "%u kbps", 100 - TXPWR_SATURATION_PCT, best, lowest->selected,
+			    sweep_kbps(&lowest->res));
+	}
+}
+
+static int txpwr_sweep_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	uint32_t duration = TXPWR_SWEEP_DURATION_DEFAULT;
+	long step = TXPWR_SWEEP_STEP_DEFAULT;
+	struct txpwr_point *p;
+	bool restore;
+	int8_t initial;
+	size_t count;
+	long from;
+	long to;
+
+	from = strtol(argv[1], NULL, 10);
+	to = strtol(argv[2], NULL, 10);
+	if (from < INT8_MIN || from > INT8_MAX || to < INT8_MIN || to > INT8_MAX) {
+		shell_error(shell, "%s: Invalid level", argv[0]);
+		return -EINVAL;
+	}
+
+	if (argc > 3) {
+		step = strtol(argv[3], NULL, 10);
+	}
+
+	if (argc > 4) {
+		duration = strtoul(argv[4], NULL, 10);
+	}
+
+	if (step <= 0 || duration == 0) {
+		shell_error(shell, "%s: Invalid step or duration", argv[0]);
+		return -EINVAL;
+	}
+
+	count = labs(to - from) / step + 1;
+	if (count > ARRAY_SIZE(txpwr_results)) {
+		shell_error(shell, "%s: At most %u levels", argv[0],
+			    (unsigned int)ARRAY_SIZE(txpwr_results));
+		return -EINVAL;
+	}
+
+	if (to < from) {
+		step = -step;
+	}
+
+	/* The power of the connection is set back after the sweep. */
+	restore = (get_tx_power(&initial) == 0);
+
+	for (size_t i = 0; i < count; i++) {
+		p = &txpwr_results[i];
+		p->requested = from + step * (long)i;
+		p->selected = p->requested;
+
+		shell_print(shell, "[%u/%u] %d dBm", (unsigned int)(i + 1), (unsigned int)count,
+			    p->requested);
+
+		p->err = set_tx_power(&p->selected);
+		if (p->err) {
+			continue;
+		}
+
+		p->reported_valid = (get_tx_power(&p->reported) == 0);
+		p->err = test_sweep_point(shell, test_params.conn_param,
+					  test_params.phy_request ? test_params.phy : NULL,
+					  test_params.data_len, test_params.mtu, duration, &p->res);
+
+		/* Without a link or with an unsupported config, the other levels would fail too. */
+		if (p->err == -EPERM || p->err == -ENOTSUP) {
+			count = i + 1;
+			break;
+		}
+	}
+
+	if (restore) {
+		set_tx_power(&initial);
+	}
+
+	txpwr_sweep_print(shell, count);
+
+	return 0;
+}
+
+#define RANGE_DURATION_DEFAULT 5000
+
+/* Coded PHYs the radio doesn't have are left empty and skipped. */
+static const struct bt_conn_le_phy_param range_phy[RANGE_PHYS] = {
+	[RANGE_PHY_1M] = { .options = BT_CONN_LE_PHY_OPT_NONE,
+			   .pref_tx_phy = BT_GAP_LE_PHY_1M, .pref_rx_phy = BT_GAP_LE_PHY_1M },
+	[RANGE_PHY_2M] = { .options = BT_CONN_LE_PHY_OPT_NONE,
+			   .pref_tx_phy = BT_GAP_LE_PHY_2M, .pref_rx_phy = BT_GAP_LE_PHY_2M },
+#if defined(RADIO_MODE_MODE_Ble_LR500Kbit) || defined(NRF5340_XXAA_APPLICATION)
+	[RANGE_PHY_S2] = { .options = BT_CONN_LE_PHY_OPT_CODED_S2,
+			   .pref_tx_phy = BT_GAP_LE_PHY_CODED, .pref_rx_phy = BT_GAP_LE_PHY_CODED },
+#endif
+#if defined(RADIO_MODE_MODE_Ble_LR125Kbit) || defined(NRF5340_XXAA_APPLICATION)
+	[RANGE_PHY_S8] = { .options = BT_CONN_LE_PHY_OPT_CODED_S8,
+			   .pref_tx_phy = BT_GAP_LE_PHY_CODED, .pref_rx_phy = BT_GAP_LE_PHY_CODED },
+#endif
+};
+
+static int range_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	range_print(shell);
+
+	return 0;
+}
+
+static int range_run_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	uint32_t duration = RANGE_DURATION_DEFAULT;
+	struct bt_conn_le_phy_param prev;
+	struct test_result res;
+	int err;
+
+	if (argc == 2) {
+		duration = strtoul(argv[1], NULL, 10);
+		if (duration == 0) {
+			shell_error(shell, "%s: Invalid duration: %s", argv[0], argv[1]);
+			return -EINVAL;
+		}
+	}
+
+	err = test_phy_get(&prev);
+	if (err) {
+		shell_error(shell, "Connect as central and wait for the link to be ready");
+		return -EPERM;
+	}
+
+	for (int phy = 0; phy < RANGE_PHYS; phy++) {
+		if (!range_phy[phy].pref_tx_phy) {
+			continue;
+		}
+
+		shell_print(shell, "[%s] %u ms", range_phy_name(phy), duration);
+		err = test_sweep_point(shell, test_params.conn_param, &range_phy[phy],
+				       test_params.data_len, test_params.mtu, duration, &res);
+		if (err) {
+			shell_error(shell, "%s: error %d", range_phy_name(phy), err);
+
+			/* Without a link or with an unsupported config, the others fail too. */
+			if (err == -EPERM || err == -ENOTSUP) {
+				return err;
+			}
+			continue;
+		}
+
+		range_result_print(shell, phy, &res);
+		range_add(phy, &res);
+	}
+
+	/* Leave the link on the PHY it had before the test. */
+	test_phy_set(shell, &prev);
+
+	shell_print(shell, "\n==== Throughput vs RSSI ====");
+	range_print(shell);
+
+	return 0;
+}
+
+static int range_reset_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	range_reset();
+	shell_print(shell, "Range results cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(range_sub,
+	SHELL_CMD_ARG(run, NULL, "Run [duration ms] on every PHY and add the results to the table",
+		      range_run_cmd, 1, 1),
+	SHELL_CMD(reset, NULL, "Clear the table", range_reset_cmd),
+	SHELL_SUBCMD_SET_END
+);
+
+static int source_load_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	uint8_t data[32];
+	size_t hex_len;
+	size_t len;
+	int err;
+
+	for (size_t i = 1; i < argc; i++) {
+		hex_len = strlen(argv[i]);
+		if (hex_len > 2 * sizeof(data)) {
+			shell_error(shell, "At most %u bytes per argument",
+				    (unsigned int)sizeof(data));
+			return -EINVAL;
+		}
+
+		len = hex2bin(argv[i], hex_len, data, sizeof(data));
+		if (len == 0) {
+			shell_error(shell, "%s: Invalid hex: %s", argv[0], argv[i]);
+			return -EINVAL;
+		}
+
+		err = source_buffer_append(data, len);
+		if (err) {
+			shell_error(shell, "Buffer full (%u bytes)",
+				    (unsigned int)source_buffer_len());
+			return err;
+		}
+	}
+
+	shell_print(shell, "Buffer: %u bytes", (unsigned int)source_buffer_len());
+
+	return 0;
+}
+
+static int source_text_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	int err = 0;
+
+	for (size_t i = 1; i < argc && !err; i++) {
+		if (i > 1) {
+			err = source_buffer_append((const uint8_t *)" ", 1);
+		}
+
+		if (!err) {
+			err = source_buffer_append((const uint8_t *)argv[i], strlen(argv[i]));
+		}
+	}
+
+	if (err) {
+		shell_error(shell, "Buffer full (%u bytes)", (unsigned int)source_buffer_len());
+		return err;
+	}
+
+	shell_print(shell, "Buffer: %u bytes", (unsigned int)source_buffer_len());
+
+	return 0;
+}
+
+static int source_clear_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	source_buffer_clear();
+	shell_print(shell, "Buffer cleared, data source: %s", source_name(source_selected()));
+
+	return 0;
+}
+
+static int source_info_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	shell_print(shell, "Data source: %s", source_name(source_selected()));
+	shell_print(shell, "Buffer: %u of %u bytes", (unsigned int)source_buffer_len(),
+		    CONFIG_BT_THROUGHPUT_SOURCE_BUF_SIZE);
+	shell_print(shell, "Flash: %u bytes", (unsigned int)source_flash_size());
+
+	return 0;
+}
+
+static int samples_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	sampler_dump(shell);
+	return 0;
 }
 
 static int test_central_cmd(const struct shell *shell, size_t argc,
@@ -302,7 +1177,32 @@ static int test_peripheral_cmd(const struct shell *shell, size_t argc,
 }
 
 SHELL_CMD_REGISTER(config, &sub_config, "Configure the example", default_cmd);
-SHELL_CMD_REGISTER(run, NULL, "Run the test", test_run_cmd);
+SHELL_CMD_REGISTER(run, NULL,
+		   "Run the test\n"
+		   "run [size], size in bytes with optional K or M suffix",
+		   test_run_cmd);
+SHELL_CMD_REGISTER(sweep, NULL,
+		   "Run the test over PHY x data length x interval x MTU and print a table\n"
+		   "sweep [duration_ms]",
+		   sweep_cmd);
+SHELL_CMD_ARG_REGISTER(txpwr_sweep, NULL,
+		       "Run the test at every connection TX power level and print a table\n"
+		       "txpwr_sweep <from_dbm> <to_dbm> [step_db] [duration_ms]",
+		       txpwr_sweep_cmd, 3, 2);
+SHELL_CMD_REGISTER(range, &range_sub,
+		   "Print the throughput vs RSSI table of the long range test", range_cmd);
+SHELL_STATIC_SUBCMD_SET_CREATE(source_cmds,
+	SHELL_CMD_ARG(load, NULL, "Append hex data to the buffer <hex> [hex...]",
+		      source_load_cmd, 2, 8),
+	SHELL_CMD_ARG(text, NULL, "Append text to the buffer <text...>", source_text_cmd, 2, 8),
+	SHELL_CMD(clear, NULL, "Empty the buffer", source_clear_cmd),
+	SHELL_CMD(info, NULL, "Print the data source sizes", source_info_cmd),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(source, &source_cmds, "Data source buffer", default_cmd);
+SHELL_CMD_REGISTER(samples, NULL, "Print the throughput samples of the last run (CSV)",
+		   samples_cmd);
 SHELL_CMD_REGISTER(central, NULL, "Select central role", test_central_cmd);
 SHELL_CMD_REGISTER(peripheral, NULL,
 		   "Select peripheral role.\n"
@@ -366,6 +1266,13 @@ static int test_get_rssi(const struct shell *shell, size_t argc, char **argv)
 	return 0;
 }
 
+static int test_rssi_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	rssi_hist_print(shell);
+
+	return 0;
+}
+
 SHELL_CMD_REGISTER(get_tx_pwr, NULL,
 		   "Get TX power for advertisement or connection\n"
 		   "(based on current state)\n"
@@ -377,3 +1284,115 @@ SHELL_CMD_REGISTER(set_tx_pwr, NULL,
 		   "Power table (Compliance Region) limits are not reflected in response\n",
 		   test_set_tx_pwr);
 SHELL_CMD_REGISTER(rssi, NULL, "Get Connection RSSI", test_get_rssi);
+static int test_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	conn_stats_print(shell);
+
+	return 0;
+}
+
+static int test_stats_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	conn_stats_reset(NULL);
+	shell_print(shell, "Connection event statistics cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(stats_sub,
+	SHELL_CMD(reset, NULL, "Clear the statistics", test_stats_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+static int test_setup_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	timeline_print(shell);
+
+	return 0;
+}
+
+static int test_setup_stats_run(const struct shell *shell, size_t argc, char **argv)
+{
+	long cycles = strtol(argv[1], NULL, 10);
+
+	if (cycles < 1) {
+		shell_error(shell, "%s: Invalid setting: %s", argv[0], argv[1]);
+		return -EINVAL;
+	}
+
+	return setup_cycles_run(shell, cycles);
+}
+
+static int test_setup_stats_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	timeline_reset();
+	shell_print(shell, "Connection setup statistics cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(setup_stats_sub,
+	SHELL_CMD_ARG(run, NULL, "Reconnect <cycles> times and print the statistics",
+		      test_setup_stats_run, 2, 0),
+	SHELL_CMD(reset, NULL, "Clear the statistics", test_setup_stats_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+static int test_gatt_cache(const struct shell *shell, size_t argc, char **argv)
+{
+	gatt_cache_print(shell);
+
+	return 0;
+}
+
+static int test_gatt_cache_clear(const struct shell *shell, size_t argc, char **argv)
+{
+	gatt_cache_clear();
+	shell_print(shell, "GATT cache cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(gatt_cache_sub,
+	SHELL_CMD(clear, NULL, "Forget all peers", test_gatt_cache_clear),
+	SHELL_SUBCMD_SET_END
+);
+
+static int test_reconnect_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	reconnect_print(shell);
+
+	return 0;
+}
+
+static int test_reconnect_stats_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	reconnect_reset();
+	shell_print(shell, "Reconnect statistics cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(reconnect_stats_sub,
+	SHELL_CMD(reset, NULL, "Clear the statistics", test_reconnect_stats_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+static int test_peer_metrics(const struct shell *shell, size_t argc, char **argv)
+{
+	return peer_ext_metrics_print(shell);
+}
+
+SHELL_CMD_REGISTER(rssi_stats, NULL, "Print the RSSI histogram of the connection (since last run)",
+		   test_rssi_stats);
+SHELL_CMD_REGISTER(peer_metrics, NULL,
+		   "Read the receiver metrics of the peer (rates, jitter, buffers, CRC errors)",
+		   test_peer_metrics);
+SHELL_CMD_REGISTER(stats, &stats_sub,
+		   "Print the controller connection event statistics (since last run)", test_stats);
+SHELL_CMD_REGISTER(setup_stats, &setup_stats_sub,
+		   "Print the connection setup time per stage (scan to ready)", test_setup_stats);
+SHELL_CMD_REGISTER(gatt_cache, &gatt_cache_sub,
+		   "Print the peers whose service handles are cached", test_gatt_cache);
+SHELL_CMD_REGISTER(reconnect_stats, &reconnect_stats_sub,
+		   "Print the time to reconnect after link loss", test_reconnect_stats);
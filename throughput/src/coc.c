@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+#include "coc.h"
+#include "payload.h"
+#include "rx_metrics.h"
+
+#define COC_PSM CONFIG_BT_THROUGHPUT_L2CAP_PSM
+
+/* Single byte SDUs are control messages from the tester; coc_send() rejects data SDUs
+ * shorter than PAYLOAD_MIN_LEN so they can't be taken for one.
+ */
+#define COC_CTRL_RESET	0x00
+#define COC_CTRL_REPORT 0x01
+
+#define COC_RX_BUF_COUNT 4
+
+/* Pending SDUs; control messages and metrics responses are sent outside the window. */
+#define COC_PENDING_COUNT (TX_WINDOW_SIZE + 2)
+
+struct coc_pending {
+	struct tx_window *win;
+	uint16_t len;
+};
+
+static struct coc {
+	struct bt_l2cap_le_chan le;
+	bool connected;
+	struct coc_pending pending[COC_PENDING_COUNT];
+	uint8_t head;
+	uint8_t tail;
+	/* Receiver metrics */
+	uint32_t rx_count;
+	uint32_t rx_len;
+	int64_t rx_first;
+	int64_t rx_last;
+	/* Tester waiting for metrics */
+	struct bt_throughput_metrics *report;
+} coc;
+
+static K_SEM_DEFINE(coc_connected_sem, 0, 1);
+static K_SEM_DEFINE(coc_report_sem, 0, 1);
+
+/* Receive buffers held by the stack or waiting for coc_recv() */
+static atomic_t coc_rx_in_use;
+
+static void coc_rx_destroy(struct net_buf *buf)
+{
+	atomic_dec(&coc_rx_in_use);
+	net_buf_destroy(buf);
+}
+
+NET_BUF_POOL_FIXED_DEFINE(coc_rx_pool, COC_RX_BUF_COUNT, BT_L2CAP_SDU_BUF_SIZE(PAYLOAD_MAX_LEN),
+			  8, coc_rx_destroy);
+NET_BUF_POOL_FIXED_DEFINE(coc_ctrl_pool, 2,
+			  BT_L2CAP_SDU_BUF_SIZE(sizeof(struct bt_throughput_metrics)), 8, NULL);
+
+static void metrics_reset(void)
+{
+	coc.rx_count = 0;
+	coc.rx_len = 0;
+	coc.rx_first = 0;
+	coc.rx_last = 0;
+}
+
+static uint32_t metrics_rate(void)
+{
+	int64_t ticks = coc.rx_last - coc.rx_first;
+
+	if (ticks <= 0) {
+		return 0;
+	}
+
+	return (uint32_t)(((uint64_t)coc.rx_len * 8 * CONFIG_SYS_CLOCK_TICKS_PER_SEC) / ticks);
+}
+
+static int chan_send(struct tx_window *win, struct net_buf *buf)
+{
+	struct coc_pending *p = &coc.pending[coc.head];
+	uint16_t len = buf->len;
+	int err;
+
+	p->win = win;
+	p->len = len;
+	coc.head = (coc.head + 1) % ARRAY_SIZE(coc.pending);
+
+	err = bt_l2cap_chan_send(&coc.le.chan, buf);
+	if (err < 0) {
+		coc.head = (coc.head + ARRAY_SIZE(coc.pending) - 1) % ARRAY_SIZE(coc.pending);
+		net_buf_unref(buf);
+		return err;
+	}
+
+	return 0;
+}
+
+static int ctrl_send(const void *data, size_t len)
+{
+	struct net_buf *buf;
+
+	buf = net_buf_alloc(&coc_ctrl_pool, K_NO_WAIT);
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+	net_buf_add_mem(buf, data, len);
+
+	return chan_send(NULL, buf);
+}
+
+static void report_send(void)
+{
+	struct bt_throughput_metrics met = {
+		.write_count = sys_cpu_to_le32(coc.rx_count),
+		.write_len = sys_cpu_to_le32(coc.rx_len),
+		.write_rate = sys_cpu_to_le32(metrics_rate()),
+	};
+	int err;
+
+	printk("\n[local] received %u bytes (%u KB) in %u SDUs at %u bps\n", coc.rx_len,
+	       coc.rx_len / 1024, coc.rx_count, metrics_rate());
+
+	err = ctrl_send(&met, sizeof(met));
+	if (err) {
+		printk("L2CAP metrics response failed (err %d)\n", err);
+	}
+}
+
+static struct net_buf *coc_alloc_buf(struct bt_l2cap_chan *chan)
+{
+	struct net_buf *buf = net_buf_alloc(&coc_rx_pool, K_FOREVER);
+
+	rx_metrics_buffers(atomic_inc(&coc_rx_in_use) + 1);
+
+	return buf;
+}
+
+static int coc_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	/* A metrics response is only expected while coc_peer_metrics() waits for one. */
+	if (coc.report && buf->len == sizeof(*coc.report)) {
+		coc.report->write_count = net_buf_pull_le32(buf);
+		coc.report->write_len = net_buf_pull_le32(buf);
+		coc.report->write_rate = net_buf_pull_le32(buf);
+		coc.report = NULL;
+		k_sem_give(&coc_report_sem);
+		return 0;
+	}
+
+	if (buf->len == 1) {
+		if (buf->data[0] == COC_CTRL_RESET) {
+			metrics_reset();
+			rx_metrics_reset();
+		} else if (buf->data[0] == COC_CTRL_REPORT) {
+			report_send();
+		}
+		return 0;
+	}
+
+	if (coc.rx_count == 0) {
+		coc.rx_first = k_uptime_ticks();
+	}
+
+	coc.rx_count++;
+	coc.rx_len += buf->len;
+	coc.rx_last = k_uptime_ticks();
+	rx_metrics_packet(buf->len);
+
+	return 0;
+}
+
+static void coc_sent(struct bt_l2cap_chan *chan)
+{
+	struct coc_pending *p = &coc.pending[coc.tail];
+
+	coc.tail = (coc.tail + 1) % ARRAY_SIZE(coc.pending);
+
+	if (p->win) {
+		tx_window_complete(p->win, p->len);
+	}
+}
+
+static void coc_connected(struct bt_l2cap_chan *chan)
+{
+	printk("L2CAP channel connected: TX MTU %u MPS %u, RX MTU %u MPS %u\n", coc.le.tx.mtu,
+	       coc.le.tx.mps, coc.le.rx.mtu, coc.le.rx.mps);
+
+	coc.connected = true;
+	coc.head = 0;
+	coc.tail = 0;
+	metrics_reset();
+
+	k_sem_give(&coc_connected_sem);
+}
+
+static void coc_disconnected(struct bt_l2cap_chan *chan)
+{
+	printk("L2CAP channel disconnected\n");
+
+	coc.connected = false;
+
+	if (coc.report) {
+		coc.report = NULL;
+		k_sem_give(&coc_report_sem);
+	}
+}
+
+static const struct bt_l2cap_chan_ops coc_ops = {
+	.alloc_buf = coc_alloc_buf,
+	.recv = coc_recv,
+	.sent = coc_sent,
+	.connected = coc_connected,
+	.disconnected = coc_disconnected,
+};
+
+static void chan_prepare(void)
+{
+	memset(&coc.le, 0, sizeof(coc.le));
+	coc.le.chan.ops = &coc_ops;
+	coc.le.rx.mtu = PAYLOAD_MAX_LEN;
+}
+
+static int coc_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+		      struct bt_l2cap_chan **chan)
+{
+	if (coc.connected) {
+		printk("L2CAP channel already in use\n");
+		return -ENOMEM;
+	}
+
+	chan_prepare();
+	*chan = &coc.le.chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server coc_server = {
+	.psm = COC_PSM,
+	.accept = coc_accept,
+};
+
+int coc_init(void)
+{
+	int err;
+
+	err = bt_l2cap_server_register(&coc_server);
+	if (err) {
+		printk("L2CAP server registration failed (err %d)\n", err);
+	}
+
+	return err;
+}
+
+int coc_connect(struct bt_conn *conn, k_timeout_t timeout)
+{
+	int err;
+
+	if (coc.connected) {
+		return 0;
+	}
+
+	chan_prepare();
+	k_sem_reset(&coc_connected_sem);
+
+	err = bt_l2cap_chan_connect(conn, &coc.le.chan, COC_PSM);
+	if (err) {
+		printk("L2CAP channel connect failed (err %d)\n", err);
+		return err;
+	}
+
+	return k_sem_take(&coc_connected_sem, timeout);
+}
+
+uint16_t coc_tx_mtu(void)
+{
+	return coc.connected ? coc.le.tx.mtu : 0;
+}
+
+int coc_send(struct tx_window *win, struct net_buf *buf, k_timeout_t timeout)
+{
+	uint16_t len = buf->len;
+	int err;
+
+	if (!coc.connected) {
+		net_buf_unref(buf);
+		return -ENOTCONN;
+	}
+
+	if (len < PAYLOAD_MIN_LEN) {
+		net_buf_unref(buf);
+		return -EINVAL;
+	}
+
+	err = tx_window_acquire(win, timeout);
+	if (err) {
+		net_buf_unref(buf);
+		return err;
+	}
+
+	err = chan_send(win, buf);
+	if (err) {
+		tx_window_cancel(win);
+		return err;
+	}
+
+	tx_window_submitted(win, len);
+
+	return 0;
+}
+
+int coc_peer_reset(void)
+{
+	static const uint8_t req = COC_CTRL_RESET;
+
+	if (!coc.connected) {
+		return -ENOTCONN;
+	}
+
+	return ctrl_send(&req, sizeof(req));
+}
+
+int coc_peer_metrics(struct bt_throughput_metrics *met, k_timeout_t timeout)
+{
+	static const uint8_t req = COC_CTRL_REPORT;
+	int err;
+
+	if (!coc.connected) {
+		return -ENOTCONN;
+	}
+
+	k_sem_reset(&coc_report_sem);
+	coc.report = met;
+
+	err = ctrl_send(&req, sizeof(req));
+	if (err) {
+		coc.report = NULL;
+		return err;
+	}
+
+	err = k_sem_take(&coc_report_sem, timeout);
+	if (err) {
+		coc.report = NULL;
+	}
+
+	return err;
+}
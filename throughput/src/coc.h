@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_COC_H_
+#define THROUGHPUT_COC_H_
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/net/buf.h>
+#include <bluetooth/services/throughput.h>
+
+#include "tx_engine.h"
+
+/** @brief Register the L2CAP server that accepts the throughput channel. */
+int coc_init(void);
+
+/**
+ * @brief Open the L2CAP credit based channel on a connection (central).
+ * Returns immediately if the channel is already open.
+ *
+ * @retval 0 when the channel is connected, -EAGAIN on timeout.
+ */
+int coc_connect(struct bt_conn *conn, k_timeout_t timeout);
+
+/** @brief Largest SDU that the peer accepts, 0 if the channel is not open. */
+uint16_t coc_tx_mtu(void);
+
+/**
+ * @brief Queue an SDU on the channel.
+ * The stack segments the SDU to the peer MPS and sends as credits allow.
+ *
+ * @param win     Window tracking the outstanding SDUs.
+ * @param buf     Payload from the payload ring. The reference is always consumed.
+ * @param timeout Maximum time to wait for a credit.
+ *
+ * @retval -EINVAL if the SDU is shorter than PAYLOAD_MIN_LEN; the peer would take it for a
+ *         control message.
+ */
+int coc_send(struct tx_window *win, struct net_buf *buf, k_timeout_t timeout);
+
+/** @brief Reset the metrics of the data received by the peer. */
+int coc_peer_reset(void);
+
+/**
+ * @brief Ask the peer for the metrics of the data received on the channel.
+ *
+ * @param met     Peer metrics (same layout as the GATT throughput service).
+ * @param timeout Maximum time to wait for the response.
+ */
+int coc_peer_metrics(struct bt_throughput_metrics *met, k_timeout_t timeout);
+
+#endif /* THROUGHPUT_COC_H_ */
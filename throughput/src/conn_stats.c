@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/shell/shell.h>
+
+#include "conn_stats.h"
+#include "sdc_vs.h"
+
+#define HANDLE_ANY    0xffff
+#define DATA_CHANNELS 37
+
+struct stats {
+	uint16_t handle;
+	uint16_t last_counter;
+	uint32_t events;
+	/* Event counter gaps: events the controller didn't serve */
+	uint32_t skipped;
+	uint32_t tx_packets;
+	uint32_t tx_acked;
+	uint32_t rx_packets;
+	uint32_t crc_errors;
+	uint32_t naks;
+	/* Events closed with a packet not acknowledged */
+	uint32_t unacked;
+	uint32_t per_event[CONN_STATS_PKT_MAX + 1];
+	uint32_t channel_events[DATA_CHANNELS];
+	uint32_t channel_crc[DATA_CHANNELS];
+};
+
+static struct k_spinlock lock;
+static struct stats stats = {.handle = HANDLE_ANY};
+static bool supported;
+
+/* Called in the Bluetooth RX thread after every connection event. */
+static bool vs_evt(struct net_buf_simple *buf)
+{
+	const struct sdc_vs_evt_qos_conn_event_report *evt;
+	k_spinlock_key_t key;
+	uint16_t handle;
+	uint16_t counter;
+
+	if (buf->len < 1 + sizeof(*evt) || buf->data[0] != SDC_VS_SUBEVENT_QOS_CONN_EVENT_REPORT) {
+		return false;
+	}
+
+	evt = (const void *)&buf->data[1];
+	handle = sys_le16_to_cpu(evt->conn_handle);
+	counter = sys_le16_to_cpu(evt->event_counter);
+
+	key = k_spin_lock(&lock);
+
+	if (stats.handle == HANDLE_ANY) {
+		stats.handle = handle;
+	}
+
+	if (handle == stats.handle) {
+		if (stats.events) {
+			stats.skipped += (uint16_t)(counter - stats.last_counter - 1);
+		}
+		stats.last_counter = counter;
+
+		stats.events++;
+		stats.tx_packets += evt->tx_packet_count;
+		stats.tx_acked += evt->tx_ack_count;
+		stats.rx_packets += evt->rx_packet_count;
+		stats.crc_errors += evt->crc_error_count;
+		stats.naks += evt->nak_count;
+		stats.unacked += (evt->tx_packet_count > evt->tx_ack_count);
+		stats.per_event[MIN(evt->tx_packet_count, CONN_STATS_PKT_MAX)]++;
+
+		if (evt->channel_index < DATA_CHANNELS) {
+			stats.channel_events[evt->channel_index]++;
+			stats.channel_crc[evt->channel_index] += evt->crc_error_count;
+		}
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return true;
+}
+
+int conn_stats_init(void)
+{
+	int err;
+
+	err = bt_hci_register_vnd_evt_cb(vs_evt);
+	if (err) {
+		return err;
+	}
+
+	/* The reports stay off until a run starts; this only checks that they exist. */
+	err = sdc_vs_qos_conn_event_report_enable(false);
+	supported = (err == 0);
+
+	return err;
+}
+
+int conn_stats_start(struct bt_conn *conn)
+{
+	if (!supported) {
+		return -ENOTSUP;
+	}
+
+	conn_stats_reset(conn);
+
+	return sdc_vs_qos_conn_event_report_enable(true);
+}
+
+void conn_stats_stop(void)
+{
+	if (supported) {
+		sdc_vs_qos_conn_event_report_enable(false);
+	}
+}
+
+void conn_stats_reset(struct bt_conn *conn)
+{
+	uint16_t handle = HANDLE_ANY;
+	k_spinlock_key_t key;
+
+	if (conn && bt_hci_get_conn_handle(conn, &handle)) {
+		handle = HANDLE_ANY;
+	}
+
+	key = k_spin_lock(&lock);
+	memset(&stats, 0, sizeof(stats));
+	stats.handle = handle;
+	k_spin_unlock(&lock, key);
+}
+
+int conn_stats_totals_get(struct conn_stats_totals *totals)
+{
+	k_spinlock_key_t key;
+
+	if (!supported) {
+		return -ENOTSUP;
+	}
+
+	key = k_spin_lock(&lock);
+	totals->events = stats.events;
+	totals->tx_packets = stats.tx_packets;
+	totals->tx_acked = stats.tx_acked;
+	totals->rx_packets = stats.rx_packets;
+	totals->crc_errors = stats.crc_errors;
+	totals->naks = stats.naks;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+void conn_stats_print(const struct shell *shell)
+{
+	static struct stats copy;
+	k_spinlock_key_t key;
+	uint32_t served;
+
+	if (!supported) {
+		shell_error(shell, "The controller doesn't send connection event reports");
+		return;
+	}
+
+	key = k_spin_lock(&lock);
+	copy = stats;
+	k_spin_unlock(&lock, key);
+
+	if (!copy.events) {
+		shell_print(shell, "No connection events since the last reset");
+		return;
+	}
+
+	served = copy.events - copy.per_event[0];
+
+	shell_print(shell, "Connection 0x%04x: %u events, %u skipped", copy.handle, copy.events,
+		    copy.skipped);
+	shell_print(shell, "TX: %u packets, %u acked, %u.%02u per event with data", copy.tx_packets,
+		    copy.tx_acked, served ? copy.tx_packets / served : 0,
+		    served ? (uint32_t)(((uint64_t)copy.tx_packets * 100 / served) % 100) : 0);
+	shell_print(shell, "RX: %u packets, %u CRC errors, %u NAKs", copy.rx_packets,
+		    copy.crc_errors, copy.naks);
+	shell_print(shell, "Events closed with a packet not acked: %u", copy.unacked);
+
+	shell_print(shell, "TX packets per event:");
+	for (int i = 0; i <= CONN_STATS_PKT_MAX; i++) {
+		if (copy.per_event[i]) {
+			shell_print(shell, "%3u%s: %u", i, i == CONN_STATS_PKT_MAX ? "+" : " ",
+				    copy.per_event[i]);
+		}
+	}
+
+	shell_print(shell, "Channels with CRC errors:");
+	for (int i = 0; i < DATA_CHANNELS; i++) {
+		if (copy.channel_crc[i]) {
+			shell_print(shell, "%3u: %u errors in %u events", i, copy.channel_crc[i],
+				    copy.channel_events[i]);
+		}
+	}
+}
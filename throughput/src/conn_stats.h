@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_CONN_STATS_H_
+#define THROUGHPUT_CONN_STATS_H_
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/shell/shell.h>
+
+/* Packets per connection event are counted up to this; the last bucket holds the rest. */
+#define CONN_STATS_PKT_MAX 16
+
+/** Totals of the connection events counted since the last reset. */
+struct conn_stats_totals {
+	uint32_t events;
+	uint32_t tx_packets;
+	uint32_t tx_acked;
+	uint32_t rx_packets;
+	uint32_t crc_errors;
+	uint32_t naks;
+};
+
+/**
+ * @brief Register for the controller connection event reports; they stay disabled.
+ * Fails with controllers that don't have the SoftDevice Controller QoS reports.
+ */
+int conn_stats_init(void);
+
+/**
+ * @brief Clear the statistics and enable the reports to count the events of conn.
+ *
+ * @retval 0 on success, -ENOTSUP if the controller doesn't send the reports.
+ */
+int conn_stats_start(struct bt_conn *conn);
+
+/** @brief Disable the reports; the statistics are kept until the next start or reset. */
+void conn_stats_stop(void);
+
+/**
+ * @brief Clear the statistics and count the events of conn.
+ * With NULL the statistics follow the first connection that reports.
+ */
+void conn_stats_reset(struct bt_conn *conn);
+
+/**
+ * @brief Get the totals.
+ *
+ * @retval 0 on success, -ENOTSUP if the controller doesn't send the reports.
+ */
+int conn_stats_totals_get(struct conn_stats_totals *totals);
+
+/** @brief Print the connection event statistics. */
+void conn_stats_print(const struct shell *shell);
+
+#endif /* THROUGHPUT_CONN_STATS_H_ */
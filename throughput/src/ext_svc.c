@@ -0,0 +1,643 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <bluetooth/gatt_dm.h>
+
+#include "ext_svc.h"
+#include "payload.h"
+#include "progress.h"
+#include "rx_metrics.h"
+#include "tx_engine.h"
+
+#define STREAM_THREAD_STACK_SIZE 1024
+#define STREAM_THREAD_PRIORITY	 K_PRIO_PREEMPT(5)
+#define STREAM_TIMEOUT		 K_SECONDS(5)
+
+static struct bt_conn *peripheral_conn;
+static atomic_t stream_enabled;
+static K_SEM_DEFINE(stream_sem, 0, 1);
+static struct tx_window stream_win;
+
+static struct {
+	struct bt_conn *conn;
+	bool available;
+	uint16_t stream;
+	uint16_t stream_ccc;
+	uint16_t verify;
+	uint16_t metrics;
+	ext_svc_discovery_cb_t cb;
+} peer;
+
+/* Peripheral: check of the verified packets */
+static struct {
+	struct ext_svc_verify_report report;
+	uint32_t next_seq;
+	/* The first packet only starts the clock of the rate */
+	uint16_t first_len;
+	int64_t first;
+	int64_t last;
+} verify_rx;
+
+static struct {
+	struct bt_gatt_read_params params;
+	struct ext_svc_verify_report report;
+	struct k_sem done;
+	int err;
+} verify_read_req;
+
+/* The metrics are longer than the default MTU; the read collects the chunks. */
+static struct {
+	struct bt_gatt_read_params params;
+	struct ext_svc_metrics met;
+	uint16_t len;
+	struct k_sem done;
+	/* Set while a read is in flight */
+	atomic_t busy;
+	/* Asynchronous read of the poll; the result is printed, nobody waits. */
+	bool poll;
+	int err;
+} metrics_req;
+
+static struct {
+	struct bt_conn *conn;
+	struct k_work_delayable work;
+	k_timeout_t period;
+	bool running;
+} metrics_poll;
+
+static struct bt_gatt_subscribe_params stream_sub;
+static struct ext_svc_rx_stats rx_stats;
+
+static void stream_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	if (value == BT_GATT_CCC_NOTIFY) {
+		atomic_set(&stream_enabled, 1);
+		k_sem_give(&stream_sem);
+	} else {
+		atomic_set(&stream_enabled, 0);
+	}
+}
+
+static uint32_t verify_crc(uint32_t seq, const uint8_t *data, uint16_t len)
+{
+	uint8_t le_seq[sizeof(seq)];
+
+	sys_put_le32(seq, le_seq);
+
+	return crc32_ieee_update(crc32_ieee(le_seq, sizeof(le_seq)), data, len);
+}
+
+static ssize_t verify_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			    const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	const struct ext_svc_verify_hdr *hdr = buf;
+	struct ext_svc_verify_report *r = &verify_rx.report;
+	uint32_t seq;
+
+	if (len < sizeof(*hdr)) {
+		r->corrupt++;
+		return len;
+	}
+
+	seq = sys_le32_to_cpu(hdr->seq);
+	if (seq == 0) {
+		memset(&verify_rx, 0, sizeof(verify_rx));
+		rx_metrics_reset();
+	}
+
+	rx_metrics_packet(len);
+
+	if (verify_crc(seq, (const uint8_t *)buf + sizeof(*hdr), len - sizeof(*hdr)) !=
+	    sys_le32_to_cpu(hdr->crc)) {
+		r->corrupt++;
+		rx_metrics_crc_error();
+		return len;
+	}
+
+	if (seq < verify_rx.next_seq) {
+		r->duplicate++;
+		return len;
+	}
+
+	r->lost += seq - verify_rx.next_seq;
+	verify_rx.next_seq = seq + 1;
+
+	verify_rx.last = k_uptime_ticks();
+	if (r->packets++ == 0) {
+		verify_rx.first = verify_rx.last;
+		verify_rx.first_len = len;
+	}
+	r->bytes += len;
+
+	return len;
+}
+
+static ssize_t verify_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			   uint16_t len, uint16_t offset)
+{
+	const struct ext_svc_verify_report *r = &verify_rx.report;
+	int64_t us = k_ticks_to_us_floor64(verify_rx.last - verify_rx.first);
+	uint32_t timed = r->bytes - verify_rx.first_len;
+	struct ext_svc_verify_report rsp = {
+		.packets = sys_cpu_to_le32(r->packets),
+		.bytes = sys_cpu_to_le32(r->bytes),
+		.lost = sys_cpu_to_le32(r->lost),
+		.duplicate = sys_cpu_to_le32(r->duplicate),
+		.corrupt = sys_cpu_to_le32(r->corrupt),
+		.rate_bps = sys_cpu_to_le32(us ? (uint64_t)timed * 8 * USEC_PER_SEC / us : 0),
+	};
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &rsp, sizeof(rsp));
+}
+
+static ssize_t metrics_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			    uint16_t len, uint16_t offset)
+{
+	struct ext_svc_metrics rsp;
+
+	/* A long read takes a new snapshot per chunk; the chunks may differ slightly. */
+	rx_metrics_get(&rsp);
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &rsp, sizeof(rsp));
+}
+
+BT_GATT_SERVICE_DEFINE(ext_svc,
+	BT_GATT_PRIMARY_SERVICE(BT_UUID_THROUGHPUT_EXT),
+	BT_GATT_CHARACTERISTIC(BT_UUID_THROUGHPUT_EXT_STREAM, BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(stream_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_THROUGHPUT_EXT_VERIFY,
+			       BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_WRITE | BT_GATT_PERM_READ, verify_read, verify_write,
+			       NULL),
+	BT_GATT_CHARACTERISTIC(BT_UUID_THROUGHPUT_EXT_METRICS, BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ, metrics_read, NULL, NULL),
+);
+
+/* Peripheral: stream notifications while the tester is subscribed. */
+static void stream_thread(void *p1, void *p2, void *p3)
+{
+	const struct bt_gatt_attr *attr = &ext_svc.attrs[2];
+	struct bt_conn *conn;
+	struct net_buf *buf;
+	uint16_t len;
+	int64_t start;
+	int64_t ms;
+	int err;
+
+	while (true) {
+		k_sem_take(&stream_sem, K_FOREVER);
+
+		conn = peripheral_conn ? bt_conn_ref(peripheral_conn) : NULL;
+		if (!conn) {
+			continue;
+		}
+
+		len = MIN(PAYLOAD_MAX_LEN, bt_gatt_get_mtu(conn) - 3);
+		tx_window_init(&stream_win, TX_WINDOW_SIZE);
+		start = k_uptime_get();
+
+		while (atomic_get(&stream_enabled)) {
+			buf = payload_get(len, STREAM_TIMEOUT);
+			if (!buf) {
+				break;
+			}
+
+			err = tx_engine_notify(&stream_win, conn, attr, buf, STREAM_TIMEOUT);
+			if (err) {
+				printk("Stream notification failed (err %d)\n", err);
+				break;
+			}
+		}
+
+		tx_window_drain(&stream_win, STREAM_TIMEOUT);
+		ms = MAX(1, k_uptime_get() - start);
+
+		printk("\n[local] streamed %u bytes (%u KB) in %lld ms at %llu kbps\n",
+		       (uint32_t)atomic_get(&stream_win.acked),
+		       (uint32_t)atomic_get(&stream_win.acked) / 1024, ms,
+		       (uint64_t)atomic_get(&stream_win.acked) * 8 / ms);
+
+		bt_conn_unref(conn);
+	}
+}
+
+K_THREAD_DEFINE(ext_svc_stream, STREAM_THREAD_STACK_SIZE, stream_thread, NULL, NULL, NULL,
+		STREAM_THREAD_PRIORITY, 0, 0);
+
+static void connected(struct bt_conn *conn, uint8_t hci_err)
+{
+	struct bt_conn_info info = {0};
+
+	if (hci_err || bt_conn_get_info(conn, &info) || info.role != BT_CONN_ROLE_PERIPHERAL) {
+		return;
+	}
+
+	if (!peripheral_conn) {
+		peripheral_conn = bt_conn_ref(conn);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	if (conn == peripheral_conn) {
+		atomic_set(&stream_enabled, 0);
+		bt_conn_unref(peripheral_conn);
+		peripheral_conn = NULL;
+	} else if (conn == peer.conn) {
+		peer.available = false;
+		peer.conn = NULL;
+	}
+}
+
+BT_CONN_CB_DEFINE(ext_svc_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+static void discovery_complete(struct bt_gatt_dm *dm, void *context)
+{
+	const struct bt_gatt_dm_attr *chrc;
+	const struct bt_gatt_dm_attr *desc;
+	struct bt_conn *conn = bt_gatt_dm_conn_get(dm);
+
+	chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_THROUGHPUT_EXT_STREAM);
+	desc = chrc ? bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_THROUGHPUT_EXT_STREAM) : NULL;
+	peer.stream = desc ? desc->handle : 0;
+	desc = chrc ? bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_GATT_CCC) : NULL;
+	peer.stream_ccc = desc ? desc->handle : 0;
+
+	/* A handle stays 0 when the characteristic is missing. */
+	chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_THROUGHPUT_EXT_VERIFY);
+	desc = chrc ? bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_THROUGHPUT_EXT_VERIFY) : NULL;
+	peer.verify = desc ? desc->handle : 0;
+
+	chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_THROUGHPUT_EXT_METRICS);
+	desc = chrc ? bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_THROUGHPUT_EXT_METRICS) : NULL;
+	peer.metrics = desc ? desc->handle : 0;
+
+	peer.available = peer.stream && peer.stream_ccc;
+	printk("Extension service discovery completed\n");
+
+	bt_gatt_dm_data_release(dm);
+
+	peer.cb(conn, peer.available);
+}
+
+static void discovery_service_not_found(struct bt_conn *conn, void *context)
+{
+	printk("Extension service not found\n");
+	peer.available = false;
+	peer.cb(conn, false);
+}
+
+static void discovery_error(struct bt_conn *conn, int err, void *context)
+{
+	printk("Error while discovering extension service: (%d)\n", err);
+	peer.available = false;
+	peer.cb(conn, false);
+}
+
+static struct bt_gatt_dm_cb discovery_cb = {
+	.completed = discovery_complete,
+	.service_not_found = discovery_service_not_found,
+	.error_found = discovery_error,
+};
+
+int ext_svc_discover(struct bt_conn *conn, ext_svc_discovery_cb_t cb)
+{
+	peer.conn = conn;
+	peer.available = false;
+	peer.stream = 0;
+	peer.stream_ccc = 0;
+	peer.verify = 0;
+	peer.metrics = 0;
+	peer.cb = cb;
+
+	return bt_gatt_dm_start(conn, BT_UUID_THROUGHPUT_EXT, &discovery_cb, NULL);
+}
+
+bool ext_svc_available(void)
+{
+	return peer.available;
+}
+
+void ext_svc_handles_get(struct ext_svc_handles *handles)
+{
+	handles->stream = peer.stream;
+	handles->stream_ccc = peer.stream_ccc;
+	handles->verify = peer.verify;
+	handles->metrics = peer.metrics;
+}
+
+void ext_svc_handles_set(struct bt_conn *conn, const struct ext_svc_handles *handles)
+{
+	peer.conn = conn;
+	peer.stream = handles->stream;
+	peer.stream_ccc = handles->stream_ccc;
+	peer.verify = handles->verify;
+	peer.metrics = handles->metrics;
+	peer.available = peer.stream && peer.stream_ccc;
+}
+
+void ext_svc_verify_stamp(struct net_buf *buf, uint32_t seq)
+{
+	struct ext_svc_verify_hdr *hdr = (struct ext_svc_verify_hdr *)buf->data;
+	uint8_t *data = buf->data + sizeof(*hdr);
+	uint16_t len = buf->len - sizeof(*hdr);
+
+	payload_pattern(data, len, seq * len);
+	hdr->seq = sys_cpu_to_le32(seq);
+	hdr->crc = sys_cpu_to_le32(verify_crc(seq, data, len));
+}
+
+uint16_t ext_svc_verify_handle(void)
+{
+	return peer.available ? peer.verify : 0;
+}
+
+static uint8_t verify_report_read_cb(struct bt_conn *conn, uint8_t att_err,
+				     struct bt_gatt_read_params *params, const void *data,
+				     uint16_t length)
+{
+	const struct ext_svc_verify_report *rsp = data;
+
+	if (att_err || !data || length != sizeof(*rsp)) {
+		verify_read_req.err = att_err ? -EIO : -EMSGSIZE;
+	} else {
+		verify_read_req.report.packets = sys_le32_to_cpu(rsp->packets);
+		verify_read_req.report.bytes = sys_le32_to_cpu(rsp->bytes);
+		verify_read_req.report.lost = sys_le32_to_cpu(rsp->lost);
+		verify_read_req.report.duplicate = sys_le32_to_cpu(rsp->duplicate);
+		verify_read_req.report.corrupt = sys_le32_to_cpu(rsp->corrupt);
+		verify_read_req.report.rate_bps = sys_le32_to_cpu(rsp->rate_bps);
+		verify_read_req.err = 0;
+	}
+
+	k_sem_give(&verify_read_req.done);
+
+	return BT_GATT_ITER_STOP;
+}
+
+int ext_svc_verify_report_read(struct bt_conn *conn, struct ext_svc_verify_report *report,
+			       k_timeout_t timeout)
+{
+	int err;
+
+	if (!ext_svc_verify_handle()) {
+		return -ENOTSUP;
+	}
+
+	k_sem_init(&verify_read_req.done, 0, 1);
+	verify_read_req.params.func = verify_report_read_cb;
+	verify_read_req.params.handle_count = 1;
+	verify_read_req.params.single.handle = peer.verify;
+	verify_read_req.params.single.offset = 0;
+
+	err = bt_gatt_read(conn, &verify_read_req.params);
+	if (err) {
+		return err;
+	}
+
+	err = k_sem_take(&verify_read_req.done, timeout);
+	if (err) {
+		return err;
+	}
+
+	*report = verify_read_req.report;
+
+	return verify_read_req.err;
+}
+
+static void metrics_from_le(struct ext_svc_metrics *met)
+{
+	met->packets = sys_le32_to_cpu(met->packets);
+	met->bytes = sys_le32_to_cpu(met->bytes);
+	met->crc_errors = sys_le32_to_cpu(met->crc_errors);
+	met->jitter_us = sys_le32_to_cpu(met->jitter_us);
+	met->rx_hwm = sys_le16_to_cpu(met->rx_hwm);
+	met->window_ms = sys_le16_to_cpu(met->window_ms);
+
+	for (size_t i = 0; i < ARRAY_SIZE(met->window_kbps); i++) {
+		met->window_kbps[i] = sys_le32_to_cpu(met->window_kbps[i]);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(met->arrival); i++) {
+		met->arrival[i] = sys_le32_to_cpu(met->arrival[i]);
+	}
+}
+
+static void metrics_poll_print(const struct ext_svc_metrics *met)
+{
+	progress_print("\n[peer] %u KB, %u kbps, jitter %u us, rx hwm %u, crc errors %u, "
+		       "RSSI %d\n", met->bytes / 1024, met->window_kbps[0], met->jitter_us,
+		       met->rx_hwm, met->crc_errors, met->rssi);
+}
+
+static uint8_t metrics_read_cb(struct bt_conn *conn, uint8_t att_err,
+			       struct bt_gatt_read_params *params, const void *data,
+			       uint16_t length)
+{
+	uint16_t offset = params->single.offset;
+
+	if (!att_err && data) {
+		if (offset + length > sizeof(metrics_req.met)) {
+			metrics_req.err = -EMSGSIZE;
+			goto done;
+		}
+
+		memcpy((uint8_t *)&metrics_req.met + offset, data, length);
+		metrics_req.len = offset + length;
+
+		/* The stack reads the next chunk, or calls again without data at the end. */
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	if (att_err) {
+		metrics_req.err = -EIO;
+	} else if (metrics_req.len != sizeof(metrics_req.met)) {
+		metrics_req.err = -EMSGSIZE;
+	} else {
+		metrics_from_le(&metrics_req.met);
+		metrics_req.err = 0;
+	}
+
+done:
+	if (metrics_req.poll) {
+		if (!metrics_req.err) {
+			metrics_poll_print(&metrics_req.met);
+		}
+		atomic_clear(&metrics_req.busy);
+	} else {
+		k_sem_give(&metrics_req.done);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+static int metrics_read_start(struct bt_conn *conn, bool poll)
+{
+	int err;
+
+	if (!peer.available || !peer.metrics) {
+		return -ENOTSUP;
+	}
+
+	if (atomic_set(&metrics_req.busy, 1)) {
+		return -EBUSY;
+	}
+
+	k_sem_init(&metrics_req.done, 0, 1);
+	metrics_req.poll = poll;
+	metrics_req.len = 0;
+	metrics_req.err = 0;
+	metrics_req.params.func = metrics_read_cb;
+	metrics_req.params.handle_count = 1;
+	metrics_req.params.single.handle = peer.metrics;
+	metrics_req.params.single.offset = 0;
+
+	err = bt_gatt_read(conn, &metrics_req.params);
+	if (err) {
+		atomic_clear(&metrics_req.busy);
+	}
+
+	return err;
+}
+
+int ext_svc_metrics_read(struct bt_conn *conn, struct ext_svc_metrics *met, k_timeout_t timeout)
+{
+	int err;
+
+	err = metrics_read_start(conn, false);
+	if (err) {
+		return err;
+	}
+
+	err = k_sem_take(&metrics_req.done, timeout);
+	if (err) {
+		/* The response may still come; it then frees the request. */
+		metrics_req.poll = true;
+		if (k_sem_take(&metrics_req.done, K_NO_WAIT) == 0) {
+			atomic_clear(&metrics_req.busy);
+		}
+		return err;
+	}
+
+	*met = metrics_req.met;
+	atomic_clear(&metrics_req.busy);
+
+	return metrics_req.err;
+}
+
+static void metrics_poll_work(struct k_work *work)
+{
+	/* Skip a period if the previous read is still in flight. */
+	(void)metrics_read_start(metrics_poll.conn, true);
+
+	if (metrics_poll.running) {
+		k_work_reschedule(&metrics_poll.work, metrics_poll.period);
+	}
+}
+
+void ext_svc_metrics_poll_start(struct bt_conn *conn, uint32_t period_ms)
+{
+	if (!peer.metrics || period_ms == 0) {
+		return;
+	}
+
+	k_work_init_delayable(&metrics_poll.work, metrics_poll_work);
+	metrics_poll.conn = conn;
+	metrics_poll.period = K_MSEC(period_ms);
+	metrics_poll.running = true;
+	k_work_reschedule(&metrics_poll.work, metrics_poll.period);
+}
+
+void ext_svc_metrics_poll_stop(void)
+{
+	struct k_work_sync sync;
+
+	if (!metrics_poll.running) {
+		return;
+	}
+
+	metrics_poll.running = false;
+	k_work_cancel_delayable_sync(&metrics_poll.work, &sync);
+
+	/* Let the last read end before the final one is requested. */
+	for (int i = 0; i < 10 && atomic_get(&metrics_req.busy); i++) {
+		k_sleep(K_MSEC(10));
+	}
+}
+
+void ext_svc_metrics_print(const struct ext_svc_metrics *met)
+{
+	printk("[peer] %u packets, %u bytes, %u crc errors, rx high water %u, jitter %u us\n",
+	       met->packets, met->bytes, met->crc_errors, met->rx_hwm, met->jitter_us);
+
+	if (met->rssi != EXT_SVC_METRICS_RSSI_NONE) {
+		printk("[peer] RSSI %d dBm\n", met->rssi);
+	}
+
+	printk("[peer] kbps per %u ms window, newest first:", met->window_ms);
+	for (size_t i = 0; i < ARRAY_SIZE(met->window_kbps); i++) {
+		printk(" %u", met->window_kbps[i]);
+	}
+	printk("\n");
+
+	printk("[peer] inter-arrival:");
+	for (size_t i = 0; i < ARRAY_SIZE(met->arrival) - 1; i++) {
+		printk(" <%uus %u", EXT_SVC_METRICS_ARRIVAL_US << i, met->arrival[i]);
+	}
+	printk(" more %u\n", met->arrival[ARRAY_SIZE(met->arrival) - 1]);
+}
+
+static uint8_t stream_notify(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+			     const void *data, uint16_t length)
+{
+	if (!data) {
+		params->value_handle = 0;
+		return BT_GATT_ITER_STOP;
+	}
+
+	rx_stats.count++;
+	rx_stats.len += length;
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+int ext_svc_stream_start(struct bt_conn *conn)
+{
+	if (!peer.available || conn != peer.conn) {
+		return -ENOTSUP;
+	}
+
+	rx_stats.count = 0;
+	rx_stats.len = 0;
+
+	stream_sub.notify = stream_notify;
+	stream_sub.value = BT_GATT_CCC_NOTIFY;
+	stream_sub.value_handle = peer.stream;
+	stream_sub.ccc_handle = peer.stream_ccc;
+	atomic_set_bit(stream_sub.flags, BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
+
+	return bt_gatt_subscribe(conn, &stream_sub);
+}
+
+int ext_svc_stream_stop(struct bt_conn *conn, struct ext_svc_rx_stats *stats)
+{
+	*stats = rx_stats;
+
+	return bt_gatt_unsubscribe(conn, &stream_sub);
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_EXT_SVC_H_
+#define THROUGHPUT_EXT_SVC_H_
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/net/buf.h>
+
+/* Throughput extension service; complements the NCS throughput service
+ * with features that the sample needs on both boards.
+ */
+#define BT_UUID_THROUGHPUT_EXT_VAL                                                                 \
+	BT_UUID_128_ENCODE(0x7a3c0001, 0x5a1e, 0x4c5d, 0x9f2b, 0x6b1d2c3e4f50)
+
+/* Peer to tester data stream (notifications) */
+#define BT_UUID_THROUGHPUT_EXT_STREAM_VAL                                                          \
+	BT_UUID_128_ENCODE(0x7a3c0002, 0x5a1e, 0x4c5d, 0x9f2b, 0x6b1d2c3e4f50)
+
+/* Tester to peer verified data (write without response); read returns the verify report */
+#define BT_UUID_THROUGHPUT_EXT_VERIFY_VAL                                                          \
+	BT_UUID_128_ENCODE(0x7a3c0003, 0x5a1e, 0x4c5d, 0x9f2b, 0x6b1d2c3e4f50)
+
+/* Receiver metrics of the peer (read) */
+#define BT_UUID_THROUGHPUT_EXT_METRICS_VAL                                                         \
+	BT_UUID_128_ENCODE(0x7a3c0004, 0x5a1e, 0x4c5d, 0x9f2b, 0x6b1d2c3e4f50)
+
+#define BT_UUID_THROUGHPUT_EXT	      BT_UUID_DECLARE_128(BT_UUID_THROUGHPUT_EXT_VAL)
+#define BT_UUID_THROUGHPUT_EXT_STREAM BT_UUID_DECLARE_128(BT_UUID_THROUGHPUT_EXT_STREAM_VAL)
+#define BT_UUID_THROUGHPUT_EXT_VERIFY BT_UUID_DECLARE_128(BT_UUID_THROUGHPUT_EXT_VERIFY_VAL)
+#define BT_UUID_THROUGHPUT_EXT_METRICS                                                             \
+	BT_UUID_DECLARE_128(BT_UUID_THROUGHPUT_EXT_METRICS_VAL)
+
+#define EXT_SVC_METRICS_WINDOWS	8
+#define EXT_SVC_METRICS_ARRIVAL_BUCKETS 12
+/* Upper limit of the first inter-arrival bucket; each next bucket doubles */
+#define EXT_SVC_METRICS_ARRIVAL_US	125
+/* RSSI not read by the peer */
+#define EXT_SVC_METRICS_RSSI_NONE	127
+
+/** Header of a verified packet (little endian).
+ * The CRC32 (IEEE) covers the sequence number and the rest of the packet.
+ * Sequence number 0 starts a new run and resets the report of the peer.
+ */
+struct ext_svc_verify_hdr {
+	uint32_t seq;
+	uint32_t crc;
+} __packed;
+
+/** Report of the verified packets received by the peer (little endian). */
+struct ext_svc_verify_report {
+	uint32_t packets;
+	uint32_t bytes;
+	/* Sequence numbers skipped */
+	uint32_t lost;
+	/* Sequence numbers received again or out of order */
+	uint32_t duplicate;
+	/* CRC mismatch or packet shorter than the header */
+	uint32_t corrupt;
+	/* Rate of the good bytes between the first and the last packet */
+	uint32_t rate_bps;
+} __packed;
+
+/** Receiver metrics of the peer (little endian), readable during and after a run.
+ * Counts the data received on every path (GATT, verify, L2CAP) since the last reset.
+ */
+struct ext_svc_metrics {
+	uint32_t packets;
+	uint32_t bytes;
+	/* Verified packets with a bad CRC */
+	uint32_t crc_errors;
+	/* Interarrival jitter estimate (RFC 3550) */
+	uint32_t jitter_us;
+	/* Most packets waiting for the receiver at once */
+	uint16_t rx_hwm;
+	uint16_t window_ms;
+	/* Rate of the last windows, newest first */
+	uint32_t window_kbps[EXT_SVC_METRICS_WINDOWS];
+	/* Inter-arrival times; bucket n holds times below EXT_SVC_METRICS_ARRIVAL_US << n,
+	 * the last bucket holds the rest.
+	 */
+	uint32_t arrival[EXT_SVC_METRICS_ARRIVAL_BUCKETS];
+	/* Average connection RSSI in dBm */
+	int8_t rssi;
+} __packed;
+
+/** Handles of the extension service on the peer; 0 if not present. */
+struct ext_svc_handles {
+	uint16_t stream;
+	uint16_t stream_ccc;
+	uint16_t verify;
+	uint16_t metrics;
+};
+
+/** Data received from the peer stream. */
+struct ext_svc_rx_stats {
+	uint32_t count;
+	uint32_t len;
+};
+
+/**
+ * @brief Called when discovery of the extension service has ended.
+ *
+ * @param conn      Connection.
+ * @param available true if the peer has the extension service.
+ */
+typedef void (*ext_svc_discovery_cb_t)(struct bt_conn *conn, bool available);
+
+/**
+ * @brief Discover the extension service on the peer (central).
+ * The callback is called when discovery ends, also if the service was not found.
+ */
+int ext_svc_discover(struct bt_conn *conn, ext_svc_discovery_cb_t cb);
+
+/** @brief true if the extension service was found on the peer. */
+bool ext_svc_available(void);
+
+/** @brief Handles found by the last discovery. */
+void ext_svc_handles_get(struct ext_svc_handles *handles);
+
+/**
+ * @brief Use handles known from an earlier discovery of the same peer instead of
+ * discovering them.
+ */
+void ext_svc_handles_set(struct bt_conn *conn, const struct ext_svc_handles *handles);
+
+/**
+ * @brief Fill a payload buffer as verified packet seq: header and a pattern continuing
+ * from the previous packet.
+ */
+void ext_svc_verify_stamp(struct net_buf *buf, uint32_t seq);
+
+/** @brief Value handle of the verify characteristic of the peer, 0 if not available. */
+uint16_t ext_svc_verify_handle(void);
+
+/**
+ * @brief Read the verify report of the peer.
+ *
+ * @param conn    Connection.
+ * @param report  Report in CPU byte order.
+ * @param timeout Maximum time to wait for the response.
+ */
+int ext_svc_verify_report_read(struct bt_conn *conn, struct ext_svc_verify_report *report,
+			       k_timeout_t timeout);
+
+/**
+ * @brief Read the receiver metrics of the peer.
+ *
+ * @param conn    Connection.
+ * @param met     Metrics in CPU byte order.
+ * @param timeout Maximum time to wait for the response.
+ */
+int ext_svc_metrics_read(struct bt_conn *conn, struct ext_svc_metrics *met, k_timeout_t timeout);
+
+/**
+ * @brief Print a summary of the peer metrics every period_ms until stopped.
+ * The reads are asynchronous and the output goes through the progress buffer.
+ */
+void ext_svc_metrics_poll_start(struct bt_conn *conn, uint32_t period_ms);
+
+/** @brief Stop printing the peer metrics. */
+void ext_svc_metrics_poll_stop(void);
+
+/** @brief Print the metrics in full. */
+void ext_svc_metrics_print(const struct ext_svc_metrics *met);
+
+/**
+ * @brief Subscribe to the peer stream. The peer streams while notifications are enabled.
+ * Resets the receive statistics.
+ */
+int ext_svc_stream_start(struct bt_conn *conn);
+
+/**
+ * @brief Unsubscribe from the peer stream.
+ *
+ * @param conn  Connection.
+ * @param stats Data received since ext_svc_stream_start().
+ */
+int ext_svc_stream_stop(struct bt_conn *conn, struct ext_svc_rx_stats *stats);
+
+#endif /* THROUGHPUT_EXT_SVC_H_ */
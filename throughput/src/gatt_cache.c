@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/addr.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/shell/shell.h>
+
+#include "gatt_cache.h"
+
+#define CACHE_SIZE CONFIG_BT_THROUGHPUT_GATT_CACHE_SIZE
+
+/* Settings key of slot n is "tput_gc/<n>" */
+#define SETTINGS_ROOT "tput_gc"
+
+static struct {
+	struct gatt_cache_entry entry;
+	/* 0 when the slot is free; higher is newer */
+	uint32_t age;
+} slots[CACHE_SIZE];
+
+static uint32_t age_next = 1;
+static K_MUTEX_DEFINE(cache_mutex);
+
+static void slot_save(size_t i)
+{
+#if defined(CONFIG_BT_SETTINGS)
+	char key[sizeof(SETTINGS_ROOT "/255")];
+	int err;
+
+	snprintf(key, sizeof(key), SETTINGS_ROOT "/%u", (unsigned int)i);
+
+	if (slots[i].age) {
+		err = settings_save_one(key, &slots[i].entry, sizeof(slots[i].entry));
+	} else {
+		err = settings_delete(key);
+	}
+
+	if (err) {
+		printk("GATT cache save failed (err %d)\n", err);
+	}
+#endif
+}
+
+#if defined(CONFIG_BT_SETTINGS)
+static int cache_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	unsigned long i = strtoul(name, NULL, 10);
+	ssize_t read;
+
+	if (i >= CACHE_SIZE || len != sizeof(slots[i].entry)) {
+		return -EINVAL;
+	}
+
+	read = read_cb(cb_arg, &slots[i].entry, sizeof(slots[i].entry));
+	if (read != sizeof(slots[i].entry)) {
+		return -EINVAL;
+	}
+
+	/* Loaded entries are older than any stored later. */
+	slots[i].age = age_next++;
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(gatt_cache, SETTINGS_ROOT, NULL, cache_set, NULL, NULL);
+#endif
+
+static int slot_find(const bt_addr_le_t *addr)
+{
+	for (size_t i = 0; i < CACHE_SIZE; i++) {
+		if (slots[i].age && bt_addr_le_eq(&slots[i].entry.addr, addr)) {
+			return i;
+		}
+	}
+
+	return -ENOENT;
+}
+
+int gatt_cache_find(const bt_addr_le_t *addr, struct gatt_cache_entry *entry)
+{
+	int i;
+
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+	i = slot_find(addr);
+	if (i >= 0) {
+		*entry = slots[i].entry;
+	}
+
+	k_mutex_unlock(&cache_mutex);
+
+	return i < 0 ? i : 0;
+}
+
+void gatt_cache_store(const struct gatt_cache_entry *entry)
+{
+	size_t oldest = 0;
+	int i;
+
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+	i = slot_find(&entry->addr);
+	if (i < 0) {
+		for (size_t n = 1; n < CACHE_SIZE; n++) {
+			if (slots[n].age < slots[oldest].age) {
+				oldest = n;
+			}
+		}
+		i = oldest;
+	}
+
+	slots[i].entry = *entry;
+	slots[i].age = age_next++;
+	slot_save(i);
+
+	k_mutex_unlock(&cache_mutex);
+}
+
+void gatt_cache_drop(const bt_addr_le_t *addr)
+{
+	int i;
+
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+	i = slot_find(addr);
+	if (i >= 0) {
+		slots[i].age = 0;
+		slot_save(i);
+	}
+
+	k_mutex_unlock(&cache_mutex);
+}
+
+void gatt_cache_clear(void)
+{
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+	for (size_t i = 0; i < CACHE_SIZE; i++) {
+		if (slots[i].age) {
+			slots[i].age = 0;
+			slot_save(i);
+		}
+	}
+
+	k_mutex_unlock(&cache_mutex);
+}
+
+void gatt_cache_print(const struct shell *shell)
+{
+	char addr[BT_ADDR_LE_STR_LEN];
+	const struct gatt_cache_entry *e;
+	size_t count = 0;
+
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+	for (size_t i = 0; i < CACHE_SIZE; i++) {
+		if (!slots[i].age) {
+			continue;
+		}
+
+		e = &slots[i].entry;
+		bt_addr_le_to_str(&e->addr, addr, sizeof(addr));
+		shell_print(shell, "%s: throughput 0x%04x, stream 0x%04x/0x%04x, verify 0x%04x, "
+			    "metrics 0x%04x", addr, e->throughput, e->ext.stream, e->ext.stream_ccc,
+			    e->ext.verify, e->ext.metrics);
+		count++;
+	}
+
+	k_mutex_unlock(&cache_mutex);
+
+	if (!count) {
+		shell_print(shell, "GATT cache is empty");
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_GATT_CACHE_H_
+#define THROUGHPUT_GATT_CACHE_H_
+
+#include <zephyr/bluetooth/addr.h>
+#include <zephyr/shell/shell.h>
+
+#include "ext_svc.h"
+
+/* Size of the GATT Database Hash characteristic value */
+#define GATT_CACHE_HASH_LEN 16
+
+/** Handles discovered on a peer. Valid while the database hash of the peer is unchanged. */
+struct gatt_cache_entry {
+	bt_addr_le_t addr;
+	uint8_t hash[GATT_CACHE_HASH_LEN];
+	/* Value handle of the throughput characteristic */
+	uint16_t throughput;
+	struct ext_svc_handles ext;
+};
+
+/**
+ * @brief Find the handles of a peer.
+ *
+ * @param addr  Identity address of the peer.
+ * @param entry Copy of the entry.
+ *
+ * @return 0 if found, -ENOENT otherwise.
+ */
+int gatt_cache_find(const bt_addr_le_t *addr, struct gatt_cache_entry *entry);
+
+/**
+ * @brief Store the handles of a peer; replaces the least recently stored peer when full.
+ * Stored in settings when CONFIG_BT_SETTINGS is enabled.
+ */
+void gatt_cache_store(const struct gatt_cache_entry *entry);
+
+/** @brief Forget the handles of a peer. */
+void gatt_cache_drop(const bt_addr_le_t *addr);
+
+/** @brief Forget all peers. */
+void gatt_cache_clear(void);
+
+/** @brief Print the cached peers. */
+void gatt_cache_print(const struct shell *shell);
+
+#endif /* THROUGHPUT_GATT_CACHE_H_ */
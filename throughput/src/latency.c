@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/printk.h>
+
+#include "latency.h"
+
+static uint16_t bucket_index(uint32_t ns)
+{
+	uint8_t msb;
+
+	if (ns < 16) {
+		return ns;
+	}
+
+	msb = 31 - __builtin_clz(ns);
+
+	return 16 + (msb - 4) * LATENCY_SUB_BUCKETS +
+	       ((ns >> (msb - 3)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/* Largest value that falls in the bucket. */
+static uint32_t bucket_limit(uint16_t index)
+{
+	uint8_t msb;
+	uint8_t sub;
+
+	if (index < 16) {
+		return index;
+	}
+
+	msb = 4 + (index - 16) / LATENCY_SUB_BUCKETS;
+	sub = (index - 16) % LATENCY_SUB_BUCKETS;
+
+	return (uint32_t)((((uint64_t)LATENCY_SUB_BUCKETS + sub + 1) << (msb - 3)) - 1);
+}
+
+void latency_init(void)
+{
+	timing_init();
+	timing_start();
+}
+
+void latency_reset(struct latency_stats *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->min_ns = UINT32_MAX;
+}
+
+void latency_add(struct latency_stats *st, uint32_t ns)
+{
+	st->count++;
+	st->sum_ns += ns;
+	st->min_ns = MIN(st->min_ns, ns);
+	st->max_ns = MAX(st->max_ns, ns);
+	st->bucket[bucket_index(ns)]++;
+}
+
+void latency_record(struct latency_stats *st, timing_t start)
+{
+	timing_t end = timing_counter_get();
+	uint64_t ns = timing_cycles_to_ns(timing_cycles_get(&start, &end));
+
+	latency_add(st, (uint32_t)MIN(ns, UINT32_MAX));
+}
+
+uint32_t latency_percentile(const struct latency_stats *st, uint8_t pct)
+{
+	uint32_t rank;
+	uint32_t seen = 0;
+
+	if (st->count == 0) {
+		return 0;
+	}
+
+	/* Rank of the sample, rounded up */
+	rank = ((uint64_t)st->count * MIN(pct, 100) + 99) / 100;
+	rank = MAX(rank, 1);
+
+	for (uint16_t i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += st->bucket[i];
+		if (seen >= rank) {
+			return CLAMP(bucket_limit(i), st->min_ns, st->max_ns);
+		}
+	}
+
+	return st->max_ns;
+}
+
+#define US_FMT	    "%u.%03u"
+#define US_ARG(ns) (ns) / 1000, (ns) % 1000
+
+void latency_print(const struct latency_stats *st, const char *name)
+{
+	uint32_t avg;
+	uint32_t p50;
+	uint32_t p99;
+
+	if (st->count == 0) {
+		printk("[%s] no samples\n", name);
+		return;
+	}
+
+	avg = (uint32_t)(st->sum_ns / st->count);
+	p50 = latency_percentile(st, 50);
+	p99 = latency_percentile(st, 99);
+
+	printk("[%s] %u samples, min " US_FMT " avg " US_FMT " p50 " US_FMT " p99 " US_FMT
+	       " max " US_FMT " us\n",
+	       name, st->count, US_ARG(st->min_ns), US_ARG(avg), US_ARG(p50), US_ARG(p99),
+	       US_ARG(st->max_ns));
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_LATENCY_H_
+#define THROUGHPUT_LATENCY_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+
+/* Values below 16 ns have their own bucket; above that each power of two
+ * is split in 8 buckets, so a percentile is within 12.5 % of the real value.
+ */
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_BUCKETS	    (16 + (32 - 4) * LATENCY_SUB_BUCKETS)
+
+/** Latency histogram (nanoseconds). */
+struct latency_stats {
+	uint32_t count;
+	uint32_t min_ns;
+	uint32_t max_ns;
+	uint64_t sum_ns;
+	uint32_t bucket[LATENCY_BUCKETS];
+};
+
+/** @brief Start the cycle counter used for the latency measurements. */
+void latency_init(void);
+
+/** @brief Clear the histogram. */
+void latency_reset(struct latency_stats *st);
+
+/** @brief Counter stamp taken before the measured operation. */
+static inline timing_t latency_stamp(void)
+{
+	return timing_counter_get();
+}
+
+/** @brief Add the time elapsed since start to the histogram. */
+void latency_record(struct latency_stats *st, timing_t start);
+
+/** @brief Add a value in nanoseconds to the histogram. */
+void latency_add(struct latency_stats *st, uint32_t ns);
+
+/**
+ * @brief Latency that pct percent of the samples don't exceed.
+ *
+ * @param pct Percentile (0 to 100).
+ *
+ * @return Upper bound of the bucket holding the percentile, 0 if the histogram is empty.
+ */
+uint32_t latency_percentile(const struct latency_stats *st, uint8_t pct);
+
+/** @brief Print count, min, avg, p50, p99 and max in microseconds. */
+void latency_print(const struct latency_stats *st, const char *name);
+
+#endif /* THROUGHPUT_LATENCY_H_ */
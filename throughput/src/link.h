@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_LINK_H_
+#define THROUGHPUT_LINK_H_
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <bluetooth/services/throughput.h>
+
+#include "tx_engine.h"
+#include "gatt_cache.h"
+
+/* Completed link layer procedures, posted to link.updates */
+#define LINK_UPDATE_PHY	     BIT(0)
+#define LINK_UPDATE_DATA_LEN BIT(1)
+#define LINK_UPDATE_PARAM    BIT(2)
+
+/** Tester state of one connection to a peer. */
+struct link {
+	struct bt_conn *conn;
+	struct bt_throughput throughput;
+	struct tx_window win;
+	struct bt_gatt_exchange_params exchange_params;
+	/* Service discovery and MTU exchange have completed */
+	bool ready;
+	/* LINK_UPDATE_* */
+	struct k_event updates;
+	/* GATT database hash of the peer, read before discovery */
+	struct bt_gatt_read_params hash_params;
+	uint8_t db_hash[GATT_CACHE_HASH_LEN];
+	bool db_hash_valid;
+	/* Handles were taken from the cache; nothing to store */
+	bool handles_cached;
+	/* Share of the TX credits when the weighted policy is used */
+	uint8_t weight;
+};
+
+#endif /* THROUGHPUT_LINK_H_ */
@@ -25,10 +25,30 @@
 #include <bluetooth/gatt_dm.h>
 
 #include <zephyr/shell/shell_uart.h>
+#include <zephyr/settings/settings.h>
 
 #include <dk_buttons_and_leds.h>
 
 #include "main.h"
+#include "tx_engine.h"
+#include "payload.h"
+#include "coc.h"
+#include "ext_svc.h"
+#include "link.h"
+#include "sched.h"
+#include "latency.h"
+#include "sampler.h"
+#include "autorun.h"
+#include "adapt.h"
+#include "rssi.h"
+#include "progress.h"
+#include "source.h"
+#include "rx_metrics.h"
+#include "report.h"
+#include "conn_stats.h"
+#include "timeline.h"
+#include "gatt_cache.h"
+#include "reconnect.h"
 
 #define VERSION_STR "2.3.0." CONFIG_BT_THROUGHPUT_BUILD_VERSION
 
@@ -38,23 +58,39 @@
 #define INTERVAL_MAX	0x140	/* 320 units, 400 ms */
 
 #define THROUGHPUT_CONFIG_TIMEOUT K_SECONDS(20)
+#define THROUGHPUT_WRITE_TIMEOUT  K_SECONDS(5)
+#define SETUP_CYCLE_TIMEOUT	  K_SECONDS(30)
+/* Time to print a full progress buffer at the console rate */
+#define PROGRESS_FLUSH_TIMEOUT                                                                     \
+	K_SECONDS(CONFIG_BT_THROUGHPUT_CONSOLE_BUF / CONFIG_BT_THROUGHPUT_CONSOLE_RATE + 1)
 
 static K_SEM_DEFINE(throughput_sem, 0, 1);
 
 static bool role_selected;
 static bool role_central;
 static int print_type = PRINT_TYPE_GRAPHICS;
-static volatile bool data_length_req;
-static volatile bool test_ready;
+static enum transport transport = TRANSPORT_GATT;
+static enum direction direction = DIRECTION_UPLINK;
+static enum sched_policy sched_policy = SCHED_ROUND_ROBIN;
+static bool adaptive;
+static bool verify;
+static enum output_format output_format = OUTPUT_TEXT;
+/* ATT MTU used by the test and write size; 0 for the negotiated MTU and the largest write */
+static uint16_t att_mtu;
+static uint16_t write_size;
+/* Last metrics read from the peer */
+static struct bt_throughput_metrics peer_met;
+static bool peer_met_valid;
+/* Sequence number of the next verified packet */
+static uint32_t verify_seq;
+/* Connection of the first link; used by single link features (RSSI, TX power, ...) */
 static struct bt_conn *default_conn;
 static uint8_t handle_type;
 static uint16_t handle;
-static struct bt_throughput throughput;
+static struct link links[CONFIG_BT_THROUGHPUT_MAX_LINKS];
 static const struct bt_uuid *uuid128 = BT_UUID_THROUGHPUT;
-static struct bt_gatt_exchange_params exchange_params;
 static struct bt_le_conn_param *conn_param =
 	BT_LE_CONN_PARAM(INTERVAL_MIN, INTERVAL_MAX, 0, 400);
-static bool connection_params_set;
 
 #if defined(CONFIG_BT_EXT_ADV)
 static bool adv_set_created;
@@ -114,6 +150,8 @@ void scan_filter_match(struct bt_scan_device_info *device_info,
 
 	printk("Filters matched. Address: %s connectable: %d RSSI: %d\n", addr, connectable,
 	       device_info->recv_info->rssi);
+
+	timeline_mark(TIMELINE_FILTER_MATCH);
 }
 
 void scan_filter_no_match(struct bt_scan_device_info *device_info,
@@ -134,13 +172,52 @@ void scan_connecting_error(struct bt_scan_device_info *device_info)
 BT_SCAN_CB_INIT(scan_cb, scan_filter_match, scan_filter_no_match,
 		scan_connecting_error, NULL);
 
+static struct link *link_find(const struct bt_conn *conn)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+		if (links[i].conn && links[i].conn == conn) {
+			return &links[i];
+		}
+	}
+
+	return NULL;
+}
+
+static size_t link_count(void)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+		if (links[i].conn) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static size_t links_ready(struct link **set)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+		if (links[i].conn && links[i].ready) {
+			set[count++] = &links[i];
+		}
+	}
+
+	return count;
+}
+
 static void exchange_func(struct bt_conn *conn, uint8_t att_err,
 			  struct bt_gatt_exchange_params *params)
 {
+	struct link *lnk = CONTAINER_OF(params, struct link, exchange_params);
 	struct bt_conn_info info = {0};
 	int err;
 
-	printk("MTU exchange %s\n", att_err == 0 ? "successful" : "failed");
+	printk("MTU exchange %s, ATT MTU %u\n", att_err == 0 ? "successful" : "failed",
+	       bt_gatt_get_mtu(conn));
 
 	err = bt_conn_get_info(conn, &info);
 	if (err) {
@@ -149,30 +226,105 @@ static void exchange_func(struct bt_conn *conn, uint8_t att_err,
 	}
 
 	if (info.role == BT_CONN_ROLE_CENTRAL) {
+		lnk->ready = true;
+		if (lnk == &links[0]) {
+			timeline_mark(TIMELINE_READY);
+			reconnect_ready();
+		}
+
+		printk("Link %u ready (%u of %u)\n", (unsigned int)ARRAY_INDEX(links, lnk),
+		       (unsigned int)link_count(),
+		       CONFIG_BT_THROUGHPUT_MAX_LINKS);
 		instruction_print();
-		test_ready = true;
+
+		/* Look for the next peer */
+		if (link_count() < CONFIG_BT_THROUGHPUT_MAX_LINKS) {
+			k_work_submit(&restart_ble);
+		}
+	}
+}
+
+/* Remember the handles of the peer for the next connection. */
+static void link_cache_store(struct link *lnk)
+{
+	struct gatt_cache_entry entry = {0};
+
+	if (!lnk->db_hash_valid || lnk->handles_cached) {
+		return;
+	}
+
+	bt_addr_le_copy(&entry.addr, bt_conn_get_dst(lnk->conn));
+	memcpy(entry.hash, lnk->db_hash, sizeof(entry.hash));
+	entry.throughput = lnk->throughput.char_handle;
+	if (lnk == &links[0]) {
+		ext_svc_handles_get(&entry.ext);
+	}
+
+	gatt_cache_store(&entry);
+}
+
+static void mtu_exchange(struct link *lnk)
+{
+	int err;
+
+	link_cache_store(lnk);
+
+	if (lnk == &links[0]) {
+		timeline_mark(TIMELINE_MTU_EXCHANGE);
+	}
+
+	lnk->exchange_params.func = exchange_func;
+
+	err = bt_gatt_exchange_mtu(lnk->conn, &lnk->exchange_params);
+	if (err) {
+		printk("MTU exchange failed (err %d)\n", err);
+	} else {
+		printk("MTU exchange pending\n");
 	}
 }
 
+static void ext_discovery_complete(struct bt_conn *conn, bool available)
+{
+	struct link *lnk = link_find(conn);
+
+	if (!lnk) {
+		return;
+	}
+
+	if (!available) {
+		printk("Duplex test not available with this peer\n");
+	}
+
+	mtu_exchange(lnk);
+}
+
 static void discovery_complete(struct bt_gatt_dm *dm,
 			       void *context)
 {
 	int err;
-	struct bt_throughput *throughput = context;
+	struct link *lnk = CONTAINER_OF(context, struct link, throughput);
 
 	printk("Service discovery completed\n");
 
 	bt_gatt_dm_data_print(dm);
-	bt_throughput_handles_assign(dm, throughput);
+	bt_throughput_handles_assign(dm, &lnk->throughput);
 	bt_gatt_dm_data_release(dm);
 
-	exchange_params.func = exchange_func;
+	if (lnk == &links[0]) {
+		timeline_mark(TIMELINE_DISCOVERED);
+	}
+
+	/* Only the first link is used for the single link tests */
+	if (lnk != &links[0]) {
+		mtu_exchange(lnk);
+		return;
+	}
 
-	err = bt_gatt_exchange_mtu(default_conn, &exchange_params);
+	/* The extension service is optional; MTU exchange follows in either case. */
+	err = ext_svc_discover(lnk->conn, ext_discovery_complete);
 	if (err) {
-		printk("MTU exchange failed (err %d)\n", err);
-	} else {
-		printk("MTU exchange pending\n");
+		printk("Extension service discovery failed (err %d)\n", err);
+		mtu_exchange(lnk);
 	}
 }
 
@@ -195,33 +347,153 @@ struct bt_gatt_dm_cb discovery_cb = {
 	.error_found       = discovery_error,
 };
 
+static void discovery_start(struct link *lnk)
+{
+	int err;
+
+	err = bt_gatt_dm_start(lnk->conn, BT_UUID_THROUGHPUT, &discovery_cb, &lnk->throughput);
+	if (err) {
+		printk("Discover failed (err %d)\n", err);
+	}
+}
+
+/* Use the handles cached for the peer if its database hash is unchanged. */
+static bool link_cache_apply(struct link *lnk)
+{
+	struct gatt_cache_entry entry;
+	int err;
+
+	if (!lnk->db_hash_valid || gatt_cache_find(bt_conn_get_dst(lnk->conn), &entry)) {
+		return false;
+	}
+
+	if (memcmp(entry.hash, lnk->db_hash, sizeof(entry.hash))) {
+		printk("Peer database changed, discovering again\n");
+		gatt_cache_drop(&entry.addr);
+		return false;
+	}
+
+	printk("Service handles taken from the GATT cache\n");
+	lnk->throughput.char_handle = entry.throughput;
+	lnk->throughput.conn = lnk->conn;
+
+	if (lnk != &links[0]) {
+		lnk->handles_cached = true;
+		mtu_exchange(lnk);
+		return true;
+	}
+
+	timeline_mark(TIMELINE_DISCOVERED);
+
+	/* Cached while the peer was not the first link; find the extension service. */
+	if (!entry.ext.stream) {
+		err = ext_svc_discover(lnk->conn, ext_discovery_complete);
+		if (!err) {
+			return true;
+		}
+	}
+
+	lnk->handles_cached = true;
+	ext_svc_handles_set(lnk->conn, &entry.ext);
+	mtu_exchange(lnk);
+
+	return true;
+}
+
+static uint8_t db_hash_read(struct bt_conn *conn, uint8_t att_err,
+			    struct bt_gatt_read_params *params, const void *data, uint16_t length)
+{
+	struct link *lnk = CONTAINER_OF(params, struct link, hash_params);
+
+	/* Peers without GATT caching have no hash and are always discovered. */
+	if (!att_err && data && length == sizeof(lnk->db_hash)) {
+		memcpy(lnk->db_hash, data, length);
+		lnk->db_hash_valid = true;
+	}
+
+	if (!link_cache_apply(lnk)) {
+		discovery_start(lnk);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+/* Read the database hash of the peer, then take the handles from the cache or discover. */
+static void service_discover(struct link *lnk)
+{
+	int err;
+
+	lnk->db_hash_valid = false;
+	lnk->handles_cached = false;
+
+	lnk->hash_params.func = db_hash_read;
+	lnk->hash_params.handle_count = 0;
+	lnk->hash_params.by_uuid.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	lnk->hash_params.by_uuid.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	lnk->hash_params.by_uuid.uuid = BT_UUID_GATT_DB_HASH;
+
+	err = bt_gatt_read(lnk->conn, &lnk->hash_params);
+	if (err) {
+		discovery_start(lnk);
+	}
+}
+
 static void connected(struct bt_conn *conn, uint8_t hci_err)
 {
 	struct bt_conn_info info = {0};
+	struct link *lnk = NULL;
 	int err;
 
 	if (hci_err) {
 		if (hci_err == BT_HCI_ERR_UNKNOWN_CONN_ID) {
 			/* Canceled creating connection */
+			if (reconnect_pending()) {
+				k_work_submit(&restart_ble);
+			}
 			return;
 		}
 
 		printk("Connection failed (err 0x%02x)\n", hci_err);
+		timeline_abort();
+
+		/* Keep looking for the lost peer */
+		if (reconnect_pending()) {
+			k_work_submit(&restart_ble);
+		}
 		return;
 	}
 
-	if (default_conn) {
+	err = bt_conn_get_info(conn, &info);
+	if (err) {
+		printk("Failed to get connection info %d\n", err);
+		return;
+	}
+
+	/* The peer is only connected to one tester. */
+	if (info.role == BT_CONN_ROLE_CENTRAL || link_count() == 0) {
+		for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+			if (!links[i].conn) {
+				lnk = &links[i];
+				break;
+			}
+		}
+	}
+
+	if (!lnk) {
 		printk("Connection exists, disconnect second connection\n");
 		bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 		return;
 	}
 
-	default_conn = bt_conn_ref(conn);
+	lnk->conn = bt_conn_ref(conn);
+	lnk->ready = false;
+	k_event_clear(&lnk->updates, UINT32_MAX);
 
-	err = bt_conn_get_info(default_conn, &info);
-	if (err) {
-		printk("Failed to get connection info %d\n", err);
-		return;
+	if (lnk == &links[0]) {
+		default_conn = lnk->conn;
+		rssi_monitor_start();
+		timeline_mark(TIMELINE_CONNECTED);
+		reconnect_connected();
 	}
 
 	printk("Connected as %s\n",
@@ -231,14 +503,7 @@ static void connected(struct bt_conn *conn, uint8_t hci_err)
 	       phy2str(info.le.phy->rx_phy));
 
 	if (info.role == BT_CONN_ROLE_CENTRAL) {
-		err = bt_gatt_dm_start(default_conn,
-				       BT_UUID_THROUGHPUT,
-				       &discovery_cb,
-				       &throughput);
-
-		if (err) {
-			printk("Discover failed (err %d)\n", err);
-		}
+		service_discover(lnk);
 	}
 }
 
@@ -260,6 +525,7 @@ static void scan_init(void)
 
 	bt_scan_init(&scan_init);
 	bt_scan_cb_register(&scan_cb);
+	reconnect_init(&scan_param, conn_param);
 
 	err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, uuid128);
 	if (err) {
@@ -280,6 +546,11 @@ static void scan_start(void)
 
 	r = bt_scan_start(BT_SCAN_TYPE_SCAN_PASSIVE);
 	printk("Start scanning: %d\n", r);
+
+	/* The setup of the first link is timed. */
+	if (!r && !links[0].conn) {
+		timeline_mark(TIMELINE_SCAN_START);
+	}
 }
 
 static void adv_start_legacy(void)
@@ -368,17 +639,30 @@ static void adv_start(void)
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	struct bt_conn_info info = {0};
+	struct link *lnk = link_find(conn);
 	int err;
 
 	printk("Disconnected (reason 0x%02x)\n", reason);
 
-	connection_params_set = false;
-	test_ready = false;
-	if (default_conn) {
-		bt_conn_unref(default_conn);
+	if (!lnk) {
+		/* Rejected second connection */
+		return;
+	}
+
+	if (lnk == &links[0]) {
+		rssi_monitor_stop();
 		default_conn = NULL;
+		timeline_abort();
+
+		if (role_central) {
+			reconnect_lost(bt_conn_get_dst(conn));
+		}
 	}
 
+	lnk->ready = false;
+	bt_conn_unref(lnk->conn);
+	lnk->conn = NULL;
+
 	err = bt_conn_get_info(conn, &info);
 	if (err) {
 		printk("Failed to get connection info (%d)\n", err);
@@ -393,11 +677,23 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 
 static void restart_ble_handler(struct k_work *work)
 {
+	int err;
+
 	ARG_UNUSED(work);
 
 	/* Re-connect using previous role */
 	if (role_central) {
-		scan_start();
+		if (link_count() >= CONFIG_BT_THROUGHPUT_MAX_LINKS) {
+			return;
+		}
+
+		/* A fast reconnect looks for the peer of the first link only. */
+		err = reconnect_scan_start();
+		if (err == -EAGAIN) {
+			scan_start();
+		} else if (!err) {
+			timeline_mark(TIMELINE_SCAN_START);
+		}
 	} else {
 		adv_start();
 	}
@@ -413,6 +709,16 @@ static bool le_param_req(struct bt_conn *conn, struct bt_le_conn_param *param)
 	return true;
 }
 
+/* Tell a waiting connection_configuration_set() that a procedure has completed. */
+static void link_update_post(struct bt_conn *conn, uint32_t update)
+{
+	struct link *lnk = link_find(conn);
+
+	if (lnk) {
+		k_event_post(&lnk->updates, update);
+	}
+}
+
 static void le_param_updated(struct bt_conn *conn, uint16_t interval,
 			     uint16_t latency, uint16_t timeout)
 {
@@ -420,7 +726,7 @@ static void le_param_updated(struct bt_conn *conn, uint16_t interval,
 	       " interval: %d, latency: %d, timeout: %d\n",
 	       interval, latency, timeout);
 
-	k_sem_give(&throughput_sem);
+	link_update_post(conn, LINK_UPDATE_PARAM);
 }
 
 static void le_phy_updated(struct bt_conn *conn,
@@ -429,22 +735,17 @@ static void le_phy_updated(struct bt_conn *conn,
 	printk("LE PHY updated: TX PHY %s, RX PHY %s\n",
 	       phy2str(param->tx_phy), phy2str(param->rx_phy));
 
-	k_sem_give(&throughput_sem);
+	link_update_post(conn, LINK_UPDATE_PHY);
 }
 
 static void le_data_length_updated(struct bt_conn *conn,
 				   struct bt_conn_le_data_len_info *info)
 {
-	if (!data_length_req) {
-		return;
-	}
-
 	printk("LE data len updated: TX (len: %d time: %d)"
 	       " RX (len: %d time: %d)\n", info->tx_max_len,
 	       info->tx_max_time, info->rx_max_len, info->rx_max_time);
 
-	data_length_req = false;
-	k_sem_give(&throughput_sem);
+	link_update_post(conn, LINK_UPDATE_DATA_LEN);
 }
 
 int read_conn_rssi(int8_t *rssi)
@@ -602,6 +903,8 @@ static uint8_t throughput_read(const struct bt_throughput_metrics *met)
 	       met->write_len, met->write_len / 1024, met->write_count,
 	       met->write_rate);
 
+	peer_met = *met;
+	peer_met_valid = true;
 	k_sem_give(&throughput_sem);
 
 	return BT_GATT_ITER_STOP;
@@ -610,24 +913,30 @@ static uint8_t throughput_read(const struct bt_throughput_metrics *met)
 static void throughput_received(const struct bt_throughput_metrics *met)
 {
 	static uint32_t kb;
+	static uint32_t last_len;
 	int8_t rssi = 127;
 
 	if (met->write_len == 0) {
 		kb = 0;
-		printk("\n");
+		last_len = 0;
+		rx_metrics_reset();
+		progress_write("\n", 1);
 
 		return;
 	}
 
+	rx_metrics_packet(met->write_len - last_len);
+	last_len = met->write_len;
+
 	if ((met->write_len / 1024) != kb) {
 		kb = (met->write_len / 1024);
 		if (print_type == PRINT_TYPE_GRAPHICS) {
-			printk("=");
+			progress_write("=", 1);
 		} else if (print_type == PRINT_TYPE_RSSI) {
-			if (read_conn_rssi(&rssi) == 0) {
-				printk("%d\n", rssi);
+			if (rssi_cached(&rssi) == 0) {
+				progress_print("%d\n", rssi);
 			} else {
-				printk("?\n");
+				progress_write("?\n", 2);
 			}
 		}
 	}
@@ -651,6 +960,145 @@ void select_print_type(const struct shell *shell, enum print_type type)
 	}
 }
 
+void select_transport(const struct shell *shell, enum transport type)
+{
+	switch (type) {
+	case TRANSPORT_L2CAP:
+		transport = type;
+		shell_print(shell, "Transport: L2CAP credit based channel");
+		break;
+	default:
+		transport = TRANSPORT_GATT;
+		shell_print(shell, "Transport: GATT write without response");
+		break;
+	}
+}
+
+void select_direction(const struct shell *shell, enum direction type)
+{
+	switch (type) {
+	case DIRECTION_DUPLEX:
+		direction = type;
+		shell_print(shell, "Direction: both (peer streams notifications)");
+		break;
+	default:
+		direction = DIRECTION_UPLINK;
+		shell_print(shell, "Direction: tester to peer");
+		break;
+	}
+}
+
+void select_sched_policy(const struct shell *shell, enum sched_policy policy)
+{
+	sched_policy = (policy == SCHED_WEIGHTED) ? SCHED_WEIGHTED : SCHED_ROUND_ROBIN;
+	shell_print(shell, "Multi link scheduling: %s",
+		    sched_policy == SCHED_WEIGHTED ? "weighted" : "round robin");
+}
+
+void select_verify(const struct shell *shell, bool enable)
+{
+	verify = enable;
+	shell_print(shell, "Data verification: %s", verify ? "on" : "off");
+}
+
+int setup_cycles_run(const struct shell *shell, uint32_t cycles)
+{
+	struct link *lnk = &links[0];
+	int err;
+
+	if (!role_central || !lnk->conn || !lnk->ready) {
+		shell_error(shell, "Connect as central and wait for the link to be ready");
+		return -EPERM;
+	}
+
+	timeline_reset();
+
+	for (uint32_t i = 0; i < cycles; i++) {
+		/* The link is set up again by restart_ble_handler(). */
+		err = bt_conn_disconnect(lnk->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		if (err) {
+			shell_error(shell, "Disconnect failed (err %d)", err);
+			return err;
+		}
+
+		err = timeline_wait(SETUP_CYCLE_TIMEOUT);
+		if (err) {
+			shell_error(shell, "Cycle %u: link not ready in time", i + 1);
+			return err;
+		}
+	}
+
+	timeline_print(shell);
+
+	return 0;
+}
+
+int select_mtu(const struct shell *shell, uint16_t mtu)
+{
+	if (mtu && (mtu < BT_ATT_DEFAULT_LE_MTU || mtu > CONFIG_BT_L2CAP_TX_MTU)) {
+		shell_error(shell, "MTU must be 0 (negotiated) or between %d and %d",
+			    BT_ATT_DEFAULT_LE_MTU, CONFIG_BT_L2CAP_TX_MTU);
+		return -EINVAL;
+	}
+
+	att_mtu = mtu;
+	if (mtu) {
+		shell_print(shell, "ATT MTU: %u (at most the negotiated MTU)", mtu);
+	} else {
+		shell_print(shell, "ATT MTU: negotiated");
+	}
+
+	return 0;
+}
+
+int select_write_size(const struct shell *shell, uint16_t size)
+{
+	if (size && (size < sizeof(struct ext_svc_verify_hdr) || size > PAYLOAD_MAX_LEN)) {
+		shell_error(shell, "Write size must be 0 (MTU - 3) or between %u and %d",
+			    (unsigned int)sizeof(struct ext_svc_verify_hdr), PAYLOAD_MAX_LEN);
+		return -EINVAL;
+	}
+
+	write_size = size;
+	if (size) {
+		shell_print(shell, "Write size: %u (at most MTU - 3)", size);
+	} else {
+		shell_print(shell, "Write size: MTU - 3");
+	}
+
+	return 0;
+}
+
+void select_output_format(const struct shell *shell, enum output_format format)
+{
+	output_format = format;
+	shell_print(shell, "Result output: %s", report_format_name(format));
+}
+
+void select_adaptive(const struct shell *shell, bool enable)
+{
+	adaptive = enable;
+	shell_print(shell, "Adaptive interval: %s", adaptive ? "on" : "off");
+}
+
+int set_link_weight(const struct shell *shell, size_t index, uint8_t weight)
+{
+	if (index >= ARRAY_SIZE(links)) {
+		shell_error(shell, "Link must be less than %d", CONFIG_BT_THROUGHPUT_MAX_LINKS);
+		return -EINVAL;
+	}
+
+	if (weight < 1 || weight > SCHED_WEIGHT_MAX) {
+		shell_error(shell, "Weight must be between 1 and %d", SCHED_WEIGHT_MAX);
+		return -EINVAL;
+	}
+
+	links[index].weight = weight;
+	shell_print(shell, "Link %u weight set to: %u", (unsigned int)index, weight);
+
+	return 0;
+}
+
 static void throughput_send(const struct bt_throughput_metrics *met)
 {
 	printk("\n[local] received %u bytes (%u KB)"
@@ -740,100 +1188,560 @@ static void buttons_init(void)
 }
 #endif
 
-static int connection_configuration_set(const struct shell *shell,
-			const struct bt_le_conn_param *conn_param,
-			const struct bt_conn_le_phy_param *phy,
-			const struct bt_conn_le_data_len_param *data_len)
+static const char *const update_name[] = {"PHY", "LE data length", "Connection parameters"};
+
+/* Procedures needed to bring the link to the requested parameters */
+static uint32_t link_update_needed(const struct bt_conn_info *info,
+				   const struct bt_le_conn_param *conn_param,
+				   const struct bt_conn_le_phy_param *phy,
+				   const struct bt_conn_le_data_len_param *data_len)
 {
-	int err;
-	struct bt_conn_info info = {0};
+	uint32_t needed = 0;
 
-	err = bt_conn_get_info(default_conn, &info);
-	if (err) {
-		shell_error(shell, "Failed to get connection info %d", err);
-		return err;
+	/* Only change PHY if the user requests it. The coding of Coded PHY can't be read back. */
+	if (phy && (info->le.phy->tx_phy != phy->pref_tx_phy ||
+		    phy->pref_tx_phy == BT_GAP_LE_PHY_CODED)) {
+		needed |= LINK_UPDATE_PHY;
 	}
 
-	if (info.role != BT_CONN_ROLE_CENTRAL) {
-		shell_error(shell,
-		"'run' command shall be executed only on the central board");
+	if (info->le.data_len->tx_max_len != data_len->tx_max_len) {
+		needed |= LINK_UPDATE_DATA_LEN;
 	}
 
-	/* Only change PHY if the user requests it. */
-	if (phy) {
-		err = bt_conn_le_phy_update(default_conn, phy);
-		if (err) {
-			shell_error(shell, "PHY update failed: %d\n", err);
-			return err;
-		}
-
-		shell_print(shell, "PHY update pending");
-		err = k_sem_take(&throughput_sem, THROUGHPUT_CONFIG_TIMEOUT);
-		if (err) {
-			shell_error(shell, "PHY update timeout");
-			return err;
-		}
+	if (info->le.interval != conn_param->interval_max) {
+		needed |= LINK_UPDATE_PARAM;
 	}
 
-	if (info.le.data_len->tx_max_len != data_len->tx_max_len) {
-		data_length_req = true;
-
-		err = bt_conn_le_data_len_update(default_conn, data_len);
-		if (err) {
-			shell_error(shell, "LE data length update failed: %d",
-				    err);
-			return err;
-		}
+	return needed;
+}
 
-		shell_print(shell, "LE Data length update pending");
-		err = k_sem_take(&throughput_sem, THROUGHPUT_CONFIG_TIMEOUT);
-		if (err) {
-			shell_error(shell, "LE Data Length update timeout");
-			return err;
-		}
+static int link_update_issue(struct link *lnk, uint32_t update,
+			     const struct bt_le_conn_param *conn_param,
+			     const struct bt_conn_le_phy_param *phy,
+			     const struct bt_conn_le_data_len_param *data_len)
+{
+	switch (update) {
+	case LINK_UPDATE_PHY:
+		return bt_conn_le_phy_update(lnk->conn, phy);
+	case LINK_UPDATE_DATA_LEN:
+		return bt_conn_le_data_len_update(lnk->conn, data_len);
+	case LINK_UPDATE_PARAM:
+		return bt_conn_le_param_update(lnk->conn, conn_param);
+	default:
+		return -EINVAL;
 	}
+}
 
-	if (info.le.interval != conn_param->interval_max) {
-		err = bt_conn_le_param_update(default_conn, conn_param);
+static int link_update_wait(const struct shell *shell, struct link *lnk, uint32_t pending)
+{
+	uint32_t done;
+
+	if (!pending) {
+		return 0;
+	}
+
+	if (k_event_wait_all(&lnk->updates, pending, false, THROUGHPUT_CONFIG_TIMEOUT)) {
+		return 0;
+	}
+
+	done = k_event_test(&lnk->updates, pending);
+	for (size_t i = 0; i < ARRAY_SIZE(update_name); i++) {
+		if ((pending & ~done) & BIT(i)) {
+			shell_error(shell, "%s update timeout", update_name[i]);
+		}
+	}
+
+	return -ETIMEDOUT;
+}
+
+/* Apply the parameters to every link. The procedures of all links are started at once
+ * and the controller runs them concurrently; one it rejects while another is in progress
+ * is retried when the others have completed.
+ */
+static int connection_configuration_set(const struct shell *shell,
+			struct link *const *set, size_t count,
+			const struct bt_le_conn_param *conn_param,
+			const struct bt_conn_le_phy_param *phy,
+			const struct bt_conn_le_data_len_param *data_len)
+{
+	uint32_t pending[CONFIG_BT_THROUGHPUT_MAX_LINKS] = {0};
+	uint32_t deferred[CONFIG_BT_THROUGHPUT_MAX_LINKS] = {0};
+	struct bt_conn_info info = {0};
+	uint32_t needed;
+	int64_t start = k_uptime_get();
+	int err;
+
+	for (size_t n = 0; n < count; n++) {
+		err = bt_conn_get_info(set[n]->conn, &info);
 		if (err) {
+			shell_error(shell, "Failed to get connection info %d", err);
+			return err;
+		}
+
+		if (info.role != BT_CONN_ROLE_CENTRAL) {
 			shell_error(shell,
-				    "Connection parameters update failed: %d",
-				    err);
+			"'run' command shall be executed only on the central board");
+		}
+
+		needed = link_update_needed(&info, conn_param, phy, data_len);
+
+		/* Updates made elsewhere (adaptive mode, the peer) also post events. */
+		k_event_clear(&set[n]->updates, needed);
+
+		for (size_t i = 0; i < ARRAY_SIZE(update_name); i++) {
+			if (!(needed & BIT(i))) {
+				continue;
+			}
+
+			if (link_update_issue(set[n], BIT(i), conn_param, phy, data_len)) {
+				deferred[n] |= BIT(i);
+			} else {
+				pending[n] |= BIT(i);
+				shell_print(shell, "%s update pending", update_name[i]);
+			}
+		}
+	}
+
+	for (size_t n = 0; n < count; n++) {
+		err = link_update_wait(shell, set[n], pending[n]);
+		if (err) {
 			return err;
 		}
 
-		shell_print(shell, "Connection parameters update pending");
-		err = k_sem_take(&throughput_sem, THROUGHPUT_CONFIG_TIMEOUT);
+		for (size_t i = 0; i < ARRAY_SIZE(update_name); i++) {
+			if (!(deferred[n] & BIT(i))) {
+				continue;
+			}
+
+			err = link_update_issue(set[n], BIT(i), conn_param, phy, data_len);
+			if (err) {
+				shell_error(shell, "%s update failed: %d", update_name[i], err);
+				return err;
+			}
+
+			shell_print(shell, "%s update pending", update_name[i]);
+			err = link_update_wait(shell, set[n], BIT(i));
+			if (err) {
+				return err;
+			}
+		}
+
+		if (pending[n] || deferred[n]) {
+			shell_print(shell, "Link %u configured in %lld ms",
+				    (unsigned int)ARRAY_INDEX(links, set[n]),
+				    k_uptime_get() - start);
+		}
+	}
+
+	return 0;
+}
+
+/* Reset the peer metrics on the selected transport. */
+static int peer_reset(const struct shell *shell, struct link *lnk)
+{
+	/* a single byte write resets the peer metrics */
+	static const uint8_t reset_req;
+	int err;
+
+	if (transport == TRANSPORT_L2CAP) {
+		err = coc_connect(lnk->conn, THROUGHPUT_CONFIG_TIMEOUT);
 		if (err) {
-			shell_error(shell,
-				    "Connection parameters update timeout");
+			shell_error(shell, "L2CAP channel not available (err %d)", err);
+			return err;
+		}
+
+		err = coc_peer_reset();
+	} else {
+		err = bt_throughput_write(&lnk->throughput, &reset_req, 1);
+	}
+
+	if (err) {
+		shell_error(shell, "Reset peer metrics failed.");
+	}
+
+	return err;
+}
+
+/* ATT MTU the test uses on the link: the negotiated one, limited by mtu if not 0 */
+static uint16_t link_mtu(struct link *lnk, uint16_t mtu)
+{
+	uint16_t negotiated = bt_gatt_get_mtu(lnk->conn);
+
+	return mtu ? MIN(negotiated, mtu) : negotiated;
+}
+
+/* Payload of one write (GATT) or SDU (L2CAP) on the link. */
+static uint16_t payload_len(struct link *lnk, uint16_t mtu)
+{
+	uint16_t len = PAYLOAD_MAX_LEN;
+
+	if (transport == TRANSPORT_L2CAP) {
+		len = MIN(len, coc_tx_mtu());
+	} else {
+		len = MIN(len, link_mtu(lnk, mtu) - 3);
+	}
+
+	return write_size ? MIN(len, write_size) : len;
+}
+
+static int payload_send(const struct shell *shell, struct link *lnk, uint16_t len)
+{
+	struct net_buf *buf;
+	int err;
+
+	buf = payload_get(len, THROUGHPUT_WRITE_TIMEOUT);
+	if (!buf) {
+		shell_error(shell, "Payload buffer timeout");
+		return -ENOBUFS;
+	}
+
+	/* Verified packets carry their own pattern. */
+	if (!verify) {
+		err = source_fill(buf);
+		if (err) {
+			shell_error(shell, "Source read failed (err %d)", err);
+			net_buf_unref(buf);
+			return err;
+		}
+	}
+
+	if (transport == TRANSPORT_L2CAP) {
+		err = coc_send(&lnk->win, buf, THROUGHPUT_WRITE_TIMEOUT);
+		if (err) {
+			shell_error(shell, "L2CAP send failed (err %d)", err);
+		}
+	} else if (verify) {
+		ext_svc_verify_stamp(buf, verify_seq++);
+		err = tx_engine_write_handle(&lnk->win, lnk->conn, ext_svc_verify_handle(), buf,
+					     THROUGHPUT_WRITE_TIMEOUT);
+		if (err) {
+			shell_error(shell, "GATT write failed (err %d)", err);
+		}
+	} else {
+		err = tx_engine_write(&lnk->win, &lnk->throughput, buf, THROUGHPUT_WRITE_TIMEOUT);
+		if (err) {
+			shell_error(shell, "GATT write failed (err %d)", err);
+		}
+	}
+
+	return err;
+}
+
+static int peer_metrics_read(const struct shell *shell, struct link *lnk)
+{
+	struct bt_throughput_metrics met;
+	int err;
+
+	peer_met_valid = false;
+
+	if (transport == TRANSPORT_L2CAP) {
+		err = coc_peer_metrics(&met, THROUGHPUT_CONFIG_TIMEOUT);
+		if (err) {
+			shell_error(shell, "L2CAP metrics request failed (err %d)", err);
 			return err;
 		}
+
+		printk("[peer] received %u bytes (%u KB) in %u SDUs at %u bps\n",
+		       met.write_len, met.write_len / 1024, met.write_count, met.write_rate);
+
+		peer_met = met;
+		peer_met_valid = true;
+
+		return 0;
+	}
+
+	/* read back char from peer */
+	err = bt_throughput_read(&lnk->throughput);
+	if (err) {
+		shell_error(shell, "GATT read failed (err %d)", err);
+		return err;
 	}
 
+	k_sem_take(&throughput_sem, THROUGHPUT_CONFIG_TIMEOUT);
+
 	return 0;
 }
 
+static int peer_ext_metrics_read(const struct shell *shell, struct ext_svc_metrics *met)
+{
+	int err;
+
+	if (!default_conn) {
+		shell_error(shell, "Device is disconnected");
+		return -ENOTCONN;
+	}
+
+	err = ext_svc_metrics_read(default_conn, met, THROUGHPUT_CONFIG_TIMEOUT);
+	if (err) {
+		shell_error(shell, "Peer metrics read failed (err %d)", err);
+		return err;
+	}
+
+	ext_svc_metrics_print(met);
+
+	return 0;
+}
+
+int peer_ext_metrics_print(const struct shell *shell)
+{
+	struct ext_svc_metrics met;
+
+	return peer_ext_metrics_read(shell, &met);
+}
+
+/* Run time in microseconds; the cycle counter resolves well below a connection interval. */
+static uint64_t run_us(uint64_t start)
+{
+	return MAX(1, k_cyc_to_us_floor64(k_cycle_get_64() - start));
+}
+
+static uint64_t rate_bps(uint32_t len, uint64_t us)
+{
+	return (uint64_t)len * 8 * USEC_PER_SEC / us;
+}
+
+static void rate_print(const char *name, const char *what, uint32_t len, uint64_t us)
+{
+	uint64_t bps = rate_bps(len, us);
+
+	printk("[%s] %s %u bytes (%u KB) in %llu.%03u ms at %llu bps (%llu kbps)\n",
+	       name, what, len, len / 1024, us / 1000, (uint32_t)(us % 1000), bps, bps / 1000);
+}
+
+/* Per direction rates of a duplex run and Jain's fairness index of the two. */
+static void duplex_print(uint32_t tx_len, uint32_t rx_len, uint64_t us)
+{
+	uint64_t tx_kbps = rate_bps(tx_len, us) / 1000;
+	uint64_t rx_kbps = rate_bps(rx_len, us) / 1000;
+	uint64_t sum_sq = tx_kbps * tx_kbps + rx_kbps * rx_kbps;
+	uint64_t fairness = sum_sq ? (100 * (tx_kbps + rx_kbps) * (tx_kbps + rx_kbps)) /
+					     (2 * sum_sq) : 0;
+
+	rate_print("local", "received", rx_len, us);
+	printk("[duplex] up %llu kbps, down %llu kbps, total %llu kbps, fairness %llu%%\n",
+	       tx_kbps, rx_kbps, tx_kbps + rx_kbps, fairness);
+}
+
+static int verify_report_print(const struct shell *shell, struct link *lnk)
+{
+	struct ext_svc_verify_report report;
+	int err;
+
+	err = ext_svc_verify_report_read(lnk->conn, &report, THROUGHPUT_CONFIG_TIMEOUT);
+	if (err) {
+		shell_error(shell, "Verify report read failed (err %d)", err);
+		return err;
+	}
+
+	printk("[peer] verified %u of %u packets (%u bytes) at %u bps\n",
+	       report.packets, verify_seq, report.bytes, report.rate_bps);
+	printk("[peer] lost %u, duplicate %u, corrupt %u\n", report.lost, report.duplicate,
+	       report.corrupt);
+
+	return 0;
+}
+
+/* Print the structured record of a single link run. */
+static void run_record_print(struct link *lnk, uint16_t len, uint32_t data, uint64_t us,
+			     const struct ext_svc_metrics *ext)
+{
+	struct bt_conn_le_data_len_info dle = {0};
+	struct bt_conn_le_phy_info phy = {0};
+	struct bt_conn_info info = {0};
+	struct run_record rec = {
+		.version = VERSION_STR,
+		.transport = (transport == TRANSPORT_L2CAP) ? "l2cap" : "gatt",
+		.mtu = link_mtu(lnk, att_mtu),
+		.write_len = len,
+		.duration_ms = (uint32_t)(us / USEC_PER_MSEC),
+		.bytes = data,
+		.kbps = (uint32_t)(rate_bps(data, us) / 1000),
+		.peer_valid = peer_met_valid,
+		.peer_bytes = peer_met.write_len,
+		.peer_kbps = peer_met.write_rate / 1000,
+	};
+
+	if (output_format == OUTPUT_TEXT) {
+		return;
+	}
+
+	if (bt_conn_get_info(lnk->conn, &info) == 0) {
+		rec.interval = info.le.interval;
+		if (info.le.phy) {
+			phy = *info.le.phy;
+		}
+		if (info.le.data_len) {
+			dle = *info.le.data_len;
+		}
+	}
+
+	rec.phy = phy.tx_phy;
+	rec.data_len = dle.tx_max_len;
+	rec.tx_power_valid = (get_tx_power(&rec.tx_power) == 0);
+
+	if (ext) {
+		rec.ext_valid = true;
+		rec.peer_crc_errors = ext->crc_errors;
+		rec.peer_jitter_us = ext->jitter_us;
+		rec.peer_rx_hwm = ext->rx_hwm;
+		rec.peer_rssi_valid = (ext->rssi != EXT_SVC_METRICS_RSSI_NONE);
+		rec.peer_rssi = ext->rssi;
+	}
+
+	report_print(output_format, &rec);
+}
+
+/* Send until the duration (cycles) has elapsed since stamp. */
+static int stream_timed(const struct shell *shell, struct link *lnk, uint16_t len,
+			uint64_t stamp, uint64_t duration, struct latency_stats *submit)
+{
+	timing_t start;
+	int err;
+
+	while (true) {
+		start = latency_stamp();
+		err = payload_send(shell, lnk, len);
+		if (err) {
+			return err;
+		}
+		latency_record(submit, start);
+
+		if (k_cycle_get_64() - stamp >= duration) {
+			return 0;
+		}
+	}
+}
+
+/* Send exactly size bytes; the last write is shorter. */
+static int stream_sized(const struct shell *shell, struct link *lnk, uint16_t len,
+			uint32_t size, struct latency_stats *submit)
+{
+	uint32_t sent = 0;
+	uint16_t chunk;
+	timing_t start;
+	int err;
+
+	while (sent < size) {
+		chunk = MIN(len, size - sent);
+		/* Split the last two writes evenly rather than end with a control message. */
+		if (size - sent > len && size - sent - len < PAYLOAD_MIN_LEN) {
+			chunk = (size - sent) / 2;
+		}
+		if (verify) {
+			/* Room for the header; may send a few bytes more than asked. */
+			chunk = MAX(chunk, sizeof(struct ext_svc_verify_hdr));
+		}
+
+		start = latency_stamp();
+		err = payload_send(shell, lnk, chunk);
+		if (err) {
+			return err;
+		}
+		latency_record(submit, start);
+
+		sent += chunk;
+	}
+
+	return 0;
+}
+
+/* Stream to every ready link at once and report per link and aggregate rates. */
+static int test_run_links(const struct shell *shell, struct link *const *set, size_t count)
+{
+	const atomic_t *acked[CONFIG_BT_THROUGHPUT_MAX_LINKS];
+	char name[sizeof("link 255")];
+	uint64_t stamp;
+	uint64_t us;
+	uint32_t data;
+	uint32_t total = 0;
+	uint16_t len = PAYLOAD_MAX_LEN;
+	int err;
+
+	if (transport != TRANSPORT_GATT || direction != DIRECTION_UPLINK) {
+		shell_error(shell, "Multi link test supports GATT uplink only");
+		return -ENOTSUP;
+	}
+
+	if (verify) {
+		shell_error(shell, "Multi link test does not support verification");
+		return -ENOTSUP;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		err = peer_reset(shell, set[i]);
+		if (err) {
+			return err;
+		}
+	}
+
+	shell_print(shell, "Sending to %u links (%s)", (unsigned int)count,
+		    sched_policy == SCHED_WEIGHTED ? "weighted" : "round robin");
+
+	sched_prepare(set, count, sched_policy);
+	for (size_t i = 0; i < count; i++) {
+		acked[i] = &set[i]->win.acked;
+	}
+
+	/* One write size for all links, the one that fits every link. */
+	for (size_t i = 0; i < count; i++) {
+		len = MIN(len, payload_len(set[i], att_mtu));
+	}
+
+	sampler_start(acked, count);
+	stamp = k_cycle_get_64();
+	err = sched_run(set, count, sched_policy, len, CONFIG_BT_THROUGHPUT_DURATION);
+	us = run_us(stamp);
+	sampler_stop();
+
+	printk("\nDone\n");
+
+	for (size_t i = 0; i < count; i++) {
+		data = atomic_get(&set[i]->win.acked);
+		total += data;
+
+		snprintk(name, sizeof(name), "link %u", (unsigned int)ARRAY_INDEX(links, set[i]));
+		rate_print(name, "sent", data, us);
+	}
+
+	rate_print("aggregate", "sent", total, us);
+
+	for (size_t i = 0; i < count; i++) {
+		printk("[link %u] ", (unsigned int)ARRAY_INDEX(links, set[i]));
+		peer_metrics_read(shell, set[i]);
+	}
+
+	return err;
+}
+
 int test_run(const struct shell *shell,
 	     const struct bt_le_conn_param *conn_param,
 	     const struct bt_conn_le_phy_param *phy,
-	     const struct bt_conn_le_data_len_param *data_len)
+	     const struct bt_conn_le_data_len_param *data_len,
+	     uint32_t size)
 {
+	struct link *set[CONFIG_BT_THROUGHPUT_MAX_LINKS];
+	struct link *lnk;
+	size_t count;
 	int err;
+	static struct latency_stats submit;
+	const atomic_t *counter;
+	uint16_t best_interval;
 	uint64_t stamp;
-	int64_t delta;
+	uint64_t duration;
+	uint64_t us;
+	timing_t start;
 	uint32_t data = 0;
 	int8_t rssi;
+	int run_err;
 
 	const char *img_ptr = img;
-	char str_buf[7];
 	int str_len;
+	uint16_t len;
+	struct ext_svc_rx_stats rx_stats;
+	struct ext_svc_metrics ext;
+	bool ext_valid;
 
-
-	/* a dummy data buffer */
-	static char dummy[495];
-
-	if (!default_conn) {
+	if (link_count() == 0) {
 		shell_error(shell, "Device is disconnected %s",
 			    "Connect to the peer device before running test");
 		return -EFAULT;
@@ -845,94 +1753,325 @@ int test_run(const struct shell *shell,
 		return -EPERM;
 	}
 
-	if (!test_ready) {
+	count = links_ready(set);
+	if (count == 0) {
 		shell_error(shell, "Device is not ready."
 			"Please wait for the service discovery and MTU exchange end");
 		return -EPERM;
 	}
 
+	if (size && size < PAYLOAD_MIN_LEN) {
+		shell_error(shell, "Size must be at least %d bytes", PAYLOAD_MIN_LEN);
+		return -EINVAL;
+	}
+
 	shell_print(shell, "\n==== Starting throughput test ====");
 
-	/* Some values can only be set once per connection */
-	if (!connection_params_set) {
-		err = connection_configuration_set(shell, conn_param, phy, data_len);
-		if (err) {
-			return err;
-		} else {
-			connection_params_set = true;
+	/* Only peer_metrics_read() of this run may fill the peer part of the record. */
+	peer_met_valid = false;
+
+	/* Every run applies the current configuration; only the changes are negotiated. */
+	err = connection_configuration_set(shell, set, count, conn_param, phy, data_len);
+	if (err) {
+		return err;
+	}
+
+	err = source_rewind();
+	if (err) {
+		shell_error(shell, "Source %s not available (err %d)",
+			    source_name(source_selected()), err);
+		return err;
+	}
+
+	if (count > 1) {
+		if (size) {
+			shell_error(shell, "Multi link test is timed; size is ignored");
 		}
+
+		err = test_run_links(shell, set, count);
+		instruction_print();
+		return err;
 	}
 
-	/* Make sure that all BLE procedures are finished. */
-	k_sleep(K_MSEC(500));
+	lnk = set[0];
 
-	/* reset peer metrics */
-	err = bt_throughput_write(&throughput, dummy, 1);
+	if (verify && (transport != TRANSPORT_GATT || !ext_svc_verify_handle())) {
+		shell_error(shell, "Verification requires GATT and the extension service");
+		return -ENOTSUP;
+	}
+
+	err = peer_reset(shell, lnk);
 	if (err) {
-		shell_error(shell, "Reset peer metrics failed.");
 		return err;
 	}
 
-	/* get cycle stamp */
-	stamp = k_uptime_get_32();
+	/* Sequence number 0 resets the verify report of the peer. */
+	verify_seq = 0;
+
+	if (direction == DIRECTION_DUPLEX) {
+		if (transport != TRANSPORT_GATT) {
+			shell_error(shell, "Duplex test requires the GATT transport");
+			return -ENOTSUP;
+		}
 
-	if (IS_ENABLED(CONFIG_BT_THROUGHPUT_FILE)) {
+		err = ext_svc_stream_start(lnk->conn);
+		if (err) {
+			shell_error(shell, "Peer stream subscribe failed (err %d)", err);
+			return err;
+		}
+	}
+
+	tx_window_init(&lnk->win, TX_WINDOW_SIZE);
+	latency_reset(&submit);
+	rssi_hist_reset();
+	conn_stats_start(lnk->conn);
+	counter = &lnk->win.acked;
+	sampler_start(&counter, 1);
+	ext_svc_metrics_poll_start(lnk->conn, CONFIG_BT_THROUGHPUT_PEER_METRICS_PERIOD);
+	len = payload_len(lnk, att_mtu);
+	shell_print(shell, "ATT MTU %u, write size %u", link_mtu(lnk, att_mtu), len);
+
+	if (adaptive) {
+		adapt_start(lnk->conn, &lnk->win);
+	}
+
+	/* get cycle stamp */
+	duration = k_ms_to_cyc_ceil64(CONFIG_BT_THROUGHPUT_DURATION);
+	stamp = k_cycle_get_64();
+
+	if (size) {
+		shell_print(shell, "Sending %u bytes from %s", size,
+			    source_name(source_selected()));
+		run_err = stream_sized(shell, lnk, len, size, &submit);
+	} else if (IS_ENABLED(CONFIG_BT_THROUGHPUT_FILE)) {
+		run_err = 0;
 		while (*img_ptr) {
-			err = bt_throughput_write(&throughput, dummy, 495);
-			if (err) {
-				shell_error(shell, "GATT write failed (err %d)", err);
+			start = latency_stamp();
+			run_err = payload_send(shell, lnk, len);
+			if (run_err) {
 				break;
 			}
+			latency_record(&submit, start);
 
 			/* The image size controls how much data is sent. */
 			str_len = (*img_ptr == '\x1b') ? 6 : 1;
-			memcpy(str_buf, img_ptr, str_len);
-			str_buf[str_len] = '\0';
-			img_ptr += str_len;
 			if (print_type == PRINT_TYPE_GRAPHICS) {
-				shell_fprintf(shell, SHELL_NORMAL, "%s", str_buf);
+				progress_write(img_ptr, str_len);
 			} else if (print_type == PRINT_TYPE_RSSI) {
-				if (read_conn_rssi(&rssi) == 0) {
-					shell_fprintf(shell, SHELL_NORMAL, "%d\n", rssi);
+				if (rssi_cached(&rssi) == 0) {
+					progress_print("%d\n", rssi);
 				}
 			}
-			data += 495;
+			img_ptr += str_len;
 		}
 	} else {
-		delta = 0;
-		while (true) {
-			err = bt_throughput_write(&throughput, dummy, 495);
-			if (err) {
-				shell_error(shell, "GATT write failed (err %d)", err);
-				break;
-			}
-			data += 495;
-			if (k_uptime_get_32() - stamp > CONFIG_BT_THROUGHPUT_DURATION) {
-				break;
-			}
+		run_err = stream_timed(shell, lnk, len, stamp, duration, &submit);
+	}
+
+	/* The test ends when the stack has sent everything that was queued. */
+	err = tx_window_drain(&lnk->win, THROUGHPUT_WRITE_TIMEOUT);
+	if (err) {
+		shell_error(shell, "%u writes still pending", tx_window_in_flight(&lnk->win));
+		run_err = run_err ? run_err : err;
+	}
+
+	data = atomic_get(&lnk->win.acked);
+	conn_stats_stop();
+	sampler_stop();
+	ext_svc_metrics_poll_stop();
+	best_interval = adaptive ? adapt_stop() : 0;
+
+	if (direction == DIRECTION_DUPLEX) {
+		err = ext_svc_stream_stop(lnk->conn, &rx_stats);
+		if (err) {
+			shell_error(shell, "Peer stream unsubscribe failed (err %d)", err);
 		}
 	}
 
-	delta = k_uptime_delta(&stamp);
+	us = run_us(stamp);
+
+	/* The console may lag the run; the results follow the progress output. */
+	progress_flush(PROGRESS_FLUSH_TIMEOUT);
+
+	/* A failed run has no valid result, so no record is printed. */
+	if (run_err) {
+		shell_error(shell, "Run failed (err %d)", run_err);
+		return run_err;
+	}
 
 	printk("\nDone\n");
-	printk("[local] sent %u bytes (%u KB) in %lld ms at %llu kbps\n",
-	       data, data / 1024, delta, ((uint64_t)data * 8 / delta));
+	rate_print("local", "sent", data, us);
+	latency_print(&submit, "write submit");
+
+	if (best_interval) {
+		printk("[adapt] best interval %u units (%u.%02u ms)\n", best_interval,
+		       best_interval * 5 / 4, (best_interval * 125) % 100);
+	}
+
+	if (print_type == PRINT_TYPE_RSSI) {
+		rssi_hist_print(shell);
+	}
+
+	if (direction == DIRECTION_DUPLEX) {
+		duplex_print(data, rx_stats.len, us);
+	}
+
+	if (verify) {
+		err = verify_report_print(shell, lnk);
+	} else {
+		err = peer_metrics_read(shell, lnk);
+	}
 
-	/* read back char from peer */
-	err = bt_throughput_read(&throughput);
 	if (err) {
-		shell_error(shell, "GATT read failed (err %d)", err);
 		return err;
 	}
 
-	k_sem_take(&throughput_sem, THROUGHPUT_CONFIG_TIMEOUT);
+	/* Catches writes the peer took for control messages, which aren't counted. */
+	if (size && peer_met_valid && peer_met.write_len != data) {
+		shell_error(shell, "Run failed: peer received %u of %u bytes", peer_met.write_len,
+			    data);
+		return -EIO;
+	}
+
+	/* Peers without the extension service don't have the extended metrics. */
+	ext_valid = ext_svc_available() && (peer_ext_metrics_read(shell, &ext) == 0);
+
+	run_record_print(lnk, len, data, us, ext_valid ? &ext : NULL);
 
 	instruction_print();
 
 	return 0;
 }
 
+int test_sweep_point(const struct shell *shell,
+		     const struct bt_le_conn_param *conn_param,
+		     const struct bt_conn_le_phy_param *phy,
+		     const struct bt_conn_le_data_len_param *data_len,
+		     uint16_t mtu, uint32_t duration_ms, struct test_result *res)
+{
+	static struct latency_stats submit;
+	struct conn_stats_totals events;
+	struct ext_svc_metrics met;
+	struct rssi_summary rssi;
+	struct link *lnk = &links[0];
+	uint64_t stamp;
+	uint16_t len;
+	int err;
+
+	memset(res, 0, sizeof(*res));
+
+	if (!lnk->conn || !lnk->ready || (role_selected && !role_central)) {
+		shell_error(shell, "Connect as central and wait for the link to be ready");
+		return -EPERM;
+	}
+
+	if (direction != DIRECTION_UPLINK) {
+		shell_error(shell, "Sweep supports uplink only");
+		return -ENOTSUP;
+	}
+
+	/* The points don't read the verify report, so stamped packets would go unchecked. */
+	if (verify) {
+		shell_error(shell, "Sweep does not support verification");
+		return -ENOTSUP;
+	}
+
+	/* Renegotiate the live connection for every point. */
+	err = connection_configuration_set(shell, &lnk, 1, conn_param, phy, data_len);
+	if (err) {
+		return err;
+	}
+
+	/* Link quality is counted on the new parameters only. */
+	rssi_hist_reset();
+
+	err = source_rewind();
+	if (err) {
+		return err;
+	}
+
+	err = peer_reset(shell, lnk);
+	if (err) {
+		return err;
+	}
+
+	/* The MTU of a live connection is fixed, so the point MTU caps the write size. */
+	len = payload_len(lnk, mtu);
+
+	tx_window_init(&lnk->win, TX_WINDOW_SIZE);
+	latency_reset(&submit);
+	conn_stats_start(lnk->conn);
+
+	stamp = k_cycle_get_64();
+	err = stream_timed(shell, lnk, len, stamp, k_ms_to_cyc_ceil64(duration_ms), &submit);
+	if (tx_window_drain(&lnk->win, THROUGHPUT_WRITE_TIMEOUT)) {
+		shell_error(shell, "%u writes still pending", tx_window_in_flight(&lnk->win));
+	}
+	conn_stats_stop();
+
+	res->bytes = atomic_get(&lnk->win.acked);
+	res->us = run_us(stamp);
+	res->len = len;
+	res->submit_p99_ns = latency_percentile(&submit, 99);
+
+	if (!rssi_hist_summary(&rssi)) {
+		res->rssi_samples = rssi.count;
+		res->rssi_avg = rssi.avg;
+		res->rssi_min = rssi.min;
+	}
+
+	if (!conn_stats_totals_get(&events)) {
+		res->events_valid = true;
+		res->tx_packets = events.tx_packets;
+		res->tx_acked = events.tx_acked;
+		res->crc_errors = events.crc_errors;
+	}
+
+	if (ext_svc_available() &&
+	    !ext_svc_metrics_read(lnk->conn, &met, THROUGHPUT_CONFIG_TIMEOUT) &&
+	    met.rssi != EXT_SVC_METRICS_RSSI_NONE) {
+		res->peer_rssi_valid = true;
+		res->peer_rssi = met.rssi;
+	}
+
+	return err;
+}
+
+int test_phy_get(struct bt_conn_le_phy_param *phy)
+{
+	struct bt_conn_info info = {0};
+
+	if (!links[0].conn || bt_conn_get_info(links[0].conn, &info)) {
+		return -ENOTCONN;
+	}
+
+	phy->options = BT_CONN_LE_PHY_OPT_NONE;
+	phy->pref_tx_phy = info.le.phy->tx_phy;
+	phy->pref_rx_phy = info.le.phy->rx_phy;
+
+	return 0;
+}
+
+int test_phy_set(const struct shell *shell, const struct bt_conn_le_phy_param *phy)
+{
+	struct link *lnk = &links[0];
+	int err;
+
+	if (!lnk->conn) {
+		return -ENOTCONN;
+	}
+
+	k_event_clear(&lnk->updates, LINK_UPDATE_PHY);
+
+	err = bt_conn_le_phy_update(lnk->conn, phy);
+	if (err) {
+		shell_error(shell, "PHY update failed: %d", err);
+		return err;
+	}
+
+	return link_update_wait(shell, lnk, LINK_UPDATE_PHY);
+}
+
 BT_CONN_CB_DEFINE(conn_callbacks) = {
 	.connected = connected,
 	.disconnected = disconnected,
@@ -957,11 +2096,34 @@ int main(void)
 
 	printk("Bluetooth initialized\n");
 
+	if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
+		settings_load();
+	}
+
+	err = conn_stats_init();
+	if (err) {
+		printk("Connection event reports not available (err %d)\n", err);
+	}
+
+	payload_init();
+	latency_init();
+
 	scan_init();
 
-	err = bt_throughput_init(&throughput, &throughput_cb);
+	for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+		links[i].weight = 1;
+		k_event_init(&links[i].updates);
+
+		err = bt_throughput_init(&links[i].throughput, &throughput_cb);
+		if (err) {
+			printk("Throughput service initialization failed.\n");
+			return 0;
+		}
+	}
+
+	err = coc_init();
 	if (err) {
-		printk("Throughput service initialization failed.\n");
+		printk("L2CAP channel initialization failed.\n");
 		return 0;
 	}
 
@@ -975,5 +2137,9 @@ int main(void)
 	printk("Type \"peripheral\" on the peripheral board.\n");
 #endif
 
+	if (IS_ENABLED(CONFIG_BT_THROUGHPUT_AUTORUN)) {
+		autorun_start();
+	}
+
 	return 0;
 }
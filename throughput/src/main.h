@@ -11,6 +11,9 @@
 #include <zephyr/shell/shell.h>
 #include <zephyr/bluetooth/conn.h>
 
+#include "sched.h"
+#include "report.h"
+
 /** These are the different options for what is printed during the throughput test. */
 enum print_type {
 	PRINT_TYPE_NONE = 0,
@@ -18,6 +21,18 @@ enum print_type {
 	PRINT_TYPE_RSSI,
 };
 
+/** Transport used to stream the test data. */
+enum transport {
+	TRANSPORT_GATT = 0,
+	TRANSPORT_L2CAP,
+};
+
+/** Direction of the test data. */
+enum direction {
+	DIRECTION_UPLINK = 0,
+	DIRECTION_DUPLEX,
+};
+
 /**
  * @brief Run the test
  *
@@ -25,11 +40,69 @@ enum print_type {
  * @param conn_param  Connection parameters.
  * @param phy         Phy parameters (if non-null).
  * @param data_len    Maximum transmission payload.
+ * @param size        Bytes to send; 0 to send the image or for CONFIG_BT_THROUGHPUT_DURATION.
  */
 int test_run(const struct shell *shell,
 	     const struct bt_le_conn_param *conn_param,
 	     const struct bt_conn_le_phy_param *phy,
-	     const struct bt_conn_le_data_len_param *data_len);
+	     const struct bt_conn_le_data_len_param *data_len,
+	     uint32_t size);
+
+/** Result of one sweep point. */
+struct test_result {
+	/* Bytes acknowledged by the stack */
+	uint32_t bytes;
+	/* Run time */
+	uint64_t us;
+	/* Write length used */
+	uint16_t len;
+	/* 99th percentile of the write submit latency */
+	uint32_t submit_p99_ns;
+	/* Connection RSSI; no samples if it could not be read */
+	uint32_t rssi_samples;
+	int8_t rssi_avg;
+	int8_t rssi_min;
+	/* Connection events; not valid without controller reports */
+	bool events_valid;
+	uint32_t tx_packets;
+	uint32_t tx_acked;
+	uint32_t crc_errors;
+	/* Average connection RSSI at the peer; not valid without the extension service */
+	bool peer_rssi_valid;
+	int8_t peer_rssi;
+};
+
+/**
+ * @brief Run one point of a parameter sweep on the first link.
+ * The connection is renegotiated to the given parameters before the run.
+ *
+ * @param shell       Shell instance where errors will be printed.
+ * @param conn_param  Connection parameters.
+ * @param phy         Phy parameters.
+ * @param data_len    Maximum transmission payload.
+ * @param mtu         ATT MTU to emulate; the write size is limited to mtu - 3.
+ * @param duration_ms Time to send.
+ * @param res         Result of the run.
+ */
+int test_sweep_point(const struct shell *shell,
+		     const struct bt_le_conn_param *conn_param,
+		     const struct bt_conn_le_phy_param *phy,
+		     const struct bt_conn_le_data_len_param *data_len,
+		     uint16_t mtu, uint32_t duration_ms, struct test_result *res);
+
+/**
+ * @brief Get the PHY of the first link.
+ * The coding of Coded PHY can't be read back; the controller selects it on restore.
+ *
+ * @retval 0 on success, -ENOTCONN without a link.
+ */
+int test_phy_get(struct bt_conn_le_phy_param *phy);
+
+/**
+ * @brief Change the PHY of the first link and wait for the update, e.g. to restore the
+ * PHY read with test_phy_get() after a sweep.
+ */
+int test_phy_set(const struct shell *shell, const struct bt_conn_le_phy_param *phy);
 
 /**
  * @brief Set the board into a specific role.
@@ -44,6 +117,65 @@ void select_role(bool is_central, const struct bt_conn_le_phy_param *phy);
  */
 void select_print_type(const struct shell *shell, enum print_type type);
 
+/**
+ * @brief Select how the test data is sent to the peer
+ */
+void select_transport(const struct shell *shell, enum transport type);
+
+/**
+ * @brief Select if the peer streams to the tester while the tester sends
+ */
+void select_direction(const struct shell *shell, enum direction type);
+
+/**
+ * @brief Select how TX credits are shared when the tester has several links
+ */
+void select_sched_policy(const struct shell *shell, enum sched_policy policy);
+
+/**
+ * @brief Send packets with a sequence number and CRC that the peer checks
+ */
+void select_verify(const struct shell *shell, bool enable);
+
+/**
+ * @brief Disconnect and set up the first link again cycles times, then print
+ * the connection setup timeline.
+ */
+int setup_cycles_run(const struct shell *shell, uint32_t cycles);
+
+/**
+ * @brief Limit the ATT MTU used by the test.
+ * The MTU exchanged at connection can't change, so a smaller MTU is emulated.
+ *
+ * @param mtu 0 for the negotiated MTU.
+ */
+int select_mtu(const struct shell *shell, uint16_t mtu);
+
+/**
+ * @brief Set the payload of each write (GATT) or SDU (L2CAP).
+ *
+ * @param size 0 for the largest payload that fits (MTU - 3 with GATT).
+ */
+int select_write_size(const struct shell *shell, uint16_t size);
+
+/**
+ * @brief Select the format of the record that ends each run
+ */
+void select_output_format(const struct shell *shell, enum output_format format);
+
+/**
+ * @brief Tune the connection interval during the run to the best rate
+ */
+void select_adaptive(const struct shell *shell, bool enable);
+
+/**
+ * @brief Set the weight of a link for the weighted scheduling policy.
+ *
+ * @param index  Link index (order of connection).
+ * @param weight 1 to SCHED_WEIGHT_MAX.
+ */
+int set_link_weight(const struct shell *shell, size_t index, uint8_t weight);
+
 /* @brief Set power. Sets ad power if advertising or idle.
  * Sets connection power if in a connection.
  * Actual power is assigned to level.
@@ -57,6 +189,11 @@ int set_tx_power(int8_t *tx_pwr_lvl);
  */
 int get_tx_power(int8_t *tx_pwr_lvl);
 
+/**
+ * @brief Read and print the extended receiver metrics of the peer.
+ */
+int peer_ext_metrics_print(const struct shell *shell);
+
 /* @brief Read connection RSSI */
 int read_conn_rssi(int8_t *rssi);
 
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+#include "payload.h"
+#include "tx_engine.h"
+
+/* One buffer per write in flight and one that the sender is preparing. */
+#define PAYLOAD_RING_COUNT (TX_WINDOW_SIZE + 1)
+
+#define PAYLOAD_USER_DATA_SIZE MAX(sizeof(void *), 8)
+
+/* Headroom is reserved so the same buffers can be handed to an L2CAP channel.
+ * User data holds the window that a GATT write was submitted on;
+ * the L2CAP layer uses the same space for its TX metadata.
+ */
+NET_BUF_POOL_FIXED_DEFINE(payload_pool, PAYLOAD_RING_COUNT,
+			  BT_L2CAP_SDU_BUF_SIZE(PAYLOAD_MAX_LEN), PAYLOAD_USER_DATA_SIZE, NULL);
+
+void payload_pattern(uint8_t *dst, size_t len, uint32_t offset)
+{
+	for (size_t i = 0; i < len; i++) {
+		dst[i] = (uint8_t)(offset + i);
+	}
+}
+
+void payload_init(void)
+{
+	struct net_buf *ring[PAYLOAD_RING_COUNT];
+	size_t i;
+
+	/* Fixed pools keep the data area of a buffer across allocations,
+	 * so filling each buffer once is enough.
+	 */
+	for (i = 0; i < ARRAY_SIZE(ring); i++) {
+		ring[i] = net_buf_alloc(&payload_pool, K_NO_WAIT);
+		if (!ring[i]) {
+			break;
+		}
+
+		net_buf_reserve(ring[i], BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+		payload_pattern(net_buf_add(ring[i], PAYLOAD_MAX_LEN), PAYLOAD_MAX_LEN, 0);
+	}
+
+	while (i--) {
+		net_buf_unref(ring[i]);
+	}
+}
+
+struct net_buf *payload_get(uint16_t len, k_timeout_t timeout)
+{
+	struct net_buf *buf;
+
+	__ASSERT_NO_MSG(len <= PAYLOAD_MAX_LEN);
+
+	buf = net_buf_alloc(&payload_pool, timeout);
+	if (!buf) {
+		return NULL;
+	}
+
+	/* Same reserve as payload_init() so data points at the pattern. */
+	net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+	net_buf_add(buf, len);
+
+	return buf;
+}
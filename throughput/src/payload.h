@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_PAYLOAD_H_
+#define THROUGHPUT_PAYLOAD_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+
+/* Largest ATT write command payload (opcode and handle use 3 bytes of the MTU) */
+#define PAYLOAD_MAX_LEN (CONFIG_BT_L2CAP_TX_MTU - 3)
+
+/* Shorter writes are control messages to the peer (metrics reset, L2CAP control) */
+#define PAYLOAD_MIN_LEN 2
+
+/**
+ * @brief Fill every buffer of the payload ring with the test pattern.
+ * The pattern is written once; buffers keep it when they are reclaimed.
+ */
+void payload_init(void);
+
+/**
+ * @brief Take a pattern filled buffer from the ring.
+ *
+ * @param len     Payload length (at most PAYLOAD_MAX_LEN).
+ * @param timeout Time to wait for a buffer to be reclaimed.
+ *
+ * @return Buffer with len bytes of pattern data, or NULL on timeout.
+ */
+struct net_buf *payload_get(uint16_t len, k_timeout_t timeout);
+
+/**
+ * @brief Generate the test pattern.
+ *
+ * @param dst    Destination.
+ * @param len    Number of bytes to generate.
+ * @param offset Position of dst within the stream; the pattern is continuous across calls.
+ */
+void payload_pattern(uint8_t *dst, size_t len, uint32_t offset);
+
+#endif /* THROUGHPUT_PAYLOAD_H_ */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include "progress.h"
+
+#define PROGRESS_STACK_SIZE 1024
+#define PROGRESS_PRIORITY   K_LOWEST_APPLICATION_THREAD_PRIO
+#define PROGRESS_TICK_MS    100
+#define PROGRESS_CHUNK	    MAX(1, CONFIG_BT_THROUGHPUT_CONSOLE_RATE * PROGRESS_TICK_MS / 1000)
+#define PROGRESS_FLUSH_POLL K_MSEC(10)
+/* Longest formatted line, the periodic peer metrics, with room to spare */
+#define PROGRESS_LINE_MAX   128
+
+RING_BUF_DECLARE(progress_ring, CONFIG_BT_THROUGHPUT_CONSOLE_BUF);
+
+/* Producers (send loop, BT RX thread) serialize on the lock; the reader doesn't need it. */
+static struct k_spinlock put_lock;
+static atomic_t dropped;
+static K_SEM_DEFINE(progress_sem, 0, 1);
+
+void progress_write(const char *str, size_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&put_lock);
+	bool fits = ring_buf_space_get(&progress_ring) >= len;
+
+	/* All or nothing, so the console never shows a partial line. */
+	if (fits) {
+		ring_buf_put(&progress_ring, (const uint8_t *)str, len);
+	}
+
+	k_spin_unlock(&put_lock, key);
+
+	if (!fits) {
+		atomic_add(&dropped, len);
+	}
+
+	k_sem_give(&progress_sem);
+}
+
+void progress_print(const char *fmt, ...)
+{
+	char str[PROGRESS_LINE_MAX];
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintk(str, sizeof(str), fmt, args);
+	va_end(args);
+
+	/* Like a full buffer, a line that doesn't fit is dropped whole. */
+	if (len >= (int)sizeof(str)) {
+		atomic_add(&dropped, len);
+		k_sem_give(&progress_sem);
+	} else if (len > 0) {
+		progress_write(str, len);
+	}
+}
+
+int progress_flush(k_timeout_t timeout)
+{
+	k_timepoint_t end = sys_timepoint_calc(timeout);
+
+	while (!ring_buf_is_empty(&progress_ring)) {
+		if (sys_timepoint_expired(end)) {
+			return -EAGAIN;
+		}
+
+		k_sleep(PROGRESS_FLUSH_POLL);
+	}
+
+	return 0;
+}
+
+/* Print at most PROGRESS_CHUNK bytes per tick, so the console is limited to the configured rate. */
+static void progress_thread(void *p1, void *p2, void *p3)
+{
+	char chunk[PROGRESS_CHUNK + 1];
+	atomic_val_t lost;
+	uint32_t len;
+
+	while (true) {
+		k_sem_take(&progress_sem, K_FOREVER);
+
+		while ((len = ring_buf_get(&progress_ring, (uint8_t *)chunk, PROGRESS_CHUNK)) > 0) {
+			chunk[len] = '\0';
+			printk("%s", chunk);
+			k_sleep(K_MSEC(PROGRESS_TICK_MS));
+		}
+
+		lost = atomic_clear(&dropped);
+		if (lost) {
+			printk("\n[%ld bytes of progress output dropped]\n", (long)lost);
+		}
+	}
+}
+
+K_THREAD_DEFINE(progress, PROGRESS_STACK_SIZE, progress_thread, NULL, NULL, NULL,
+		PROGRESS_PRIORITY, 0, 0);
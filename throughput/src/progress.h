@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_PROGRESS_H_
+#define THROUGHPUT_PROGRESS_H_
+
+#include <stddef.h>
+#include <zephyr/kernel.h>
+
+/**
+ * @brief Queue progress output (image glyphs, '=' per KB, RSSI values).
+ * Never blocks; the text is printed by a low priority thread at no more than
+ * CONFIG_BT_THROUGHPUT_CONSOLE_RATE bytes per second. Text that doesn't fit
+ * in the buffer is dropped and the number of dropped bytes is printed later.
+ */
+void progress_write(const char *str, size_t len);
+
+/** @brief Formatted progress_write(); lines longer than 127 characters are dropped. */
+void progress_print(const char *fmt, ...);
+
+/**
+ * @brief Wait until the queued output has been printed, e.g. before the results.
+ *
+ * @retval 0 when the buffer is empty, -EAGAIN on timeout.
+ */
+int progress_flush(k_timeout_t timeout);
+
+#endif /* THROUGHPUT_PROGRESS_H_ */
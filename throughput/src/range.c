@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/shell/shell.h>
+
+#include "range.h"
+
+#define BINS ((RANGE_RSSI_MAX - RANGE_RSSI_MIN) / RANGE_RSSI_STEP)
+
+struct cell {
+	uint32_t runs;
+	uint64_t bytes;
+	uint64_t us;
+	/* Runs with connection event reports */
+	uint32_t event_runs;
+	uint32_t tx_packets;
+	uint32_t tx_acked;
+};
+
+static const char *const phy_name[RANGE_PHYS] = {
+	"1M", "2M", "S2", "S8",
+};
+
+static struct cell table[BINS][RANGE_PHYS];
+
+static int bin_of(int8_t rssi)
+{
+	return CLAMP((rssi - RANGE_RSSI_MIN) / RANGE_RSSI_STEP, 0, BINS - 1);
+}
+
+static uint32_t kbps(uint64_t bytes, uint64_t us)
+{
+	return us ? (uint32_t)(bytes * 8 * 1000 / us) : 0;
+}
+
+/* Packets sent again, in 0.01 % of the packets sent */
+static uint32_t per(uint32_t sent, uint32_t acked)
+{
+	return sent ? (uint32_t)((uint64_t)(sent - MIN(acked, sent)) * 10000 / sent) : 0;
+}
+
+const char *range_phy_name(enum range_phy phy)
+{
+	return phy < RANGE_PHYS ? phy_name[phy] : "?";
+}
+
+void range_add(enum range_phy phy, const struct test_result *res)
+{
+	struct cell *c;
+
+	if (phy >= RANGE_PHYS || !res->rssi_samples) {
+		return;
+	}
+
+	c = &table[bin_of(res->rssi_avg)][phy];
+	c->runs++;
+	c->bytes += res->bytes;
+	c->us += res->us;
+
+	if (res->events_valid) {
+		c->event_runs++;
+		c->tx_packets += res->tx_packets;
+		c->tx_acked += res->tx_acked;
+	}
+}
+
+void range_result_print(const struct shell *shell, enum range_phy phy,
+			const struct test_result *res)
+{
+	uint32_t rate = per(res->tx_packets, res->tx_acked);
+
+	shell_print(shell, "%s: %u kbps", range_phy_name(phy), kbps(res->bytes, res->us));
+
+	if (res->rssi_samples) {
+		shell_print(shell, "  RSSI avg %d min %d dBm (%u samples)", res->rssi_avg,
+			    res->rssi_min, res->rssi_samples);
+	} else {
+		shell_print(shell, "  RSSI not read");
+	}
+
+	if (res->events_valid) {
+		shell_print(shell, "  %u packets, %u not acked (%u.%02u %%), %u CRC errors",
+			    res->tx_packets, res->tx_packets - MIN(res->tx_acked, res->tx_packets),
+			    rate / 100, rate % 100, res->crc_errors);
+	} else {
+		shell_print(shell, "  Packet errors not available");
+	}
+}
+
+void range_reset(void)
+{
+	memset(table, 0, sizeof(table));
+}
+
+void range_print(const struct shell *shell)
+{
+	char line[16 + RANGE_PHYS * 18];
+	const struct cell *c;
+	uint32_t rate;
+	bool empty = true;
+	bool row;
+	int len;
+
+	len = snprintf(line, sizeof(line), "%-12s", "RSSI (dBm)");
+	for (int p = 0; p < RANGE_PHYS; p++) {
+		len += snprintf(&line[len], sizeof(line) - len, " %4s kbps  PER %%", phy_name[p]);
+	}
+	shell_print(shell, "%s", line);
+
+	for (int b = BINS - 1; b >= 0; b--) {
+		len = snprintf(line, sizeof(line), "%4d..%-4d  ",
+			       RANGE_RSSI_MIN + b * RANGE_RSSI_STEP,
+			       RANGE_RSSI_MIN + (b + 1) * RANGE_RSSI_STEP - 1);
+		row = false;
+
+		for (int p = 0; p < RANGE_PHYS; p++) {
+			c = &table[b][p];
+
+			if (!c->runs) {
+				len += snprintf(&line[len], sizeof(line) - len, " %9s %6s", "-",
+						"-");
+				continue;
+			}
+
+			row = true;
+			len += snprintf(&line[len], sizeof(line) - len, " %9u",
+					kbps(c->bytes, c->us));
+
+			if (c->event_runs) {
+				rate = per(c->tx_packets, c->tx_acked);
+				len += snprintf(&line[len], sizeof(line) - len, " %3u.%02u",
+						rate / 100, rate % 100);
+			} else {
+				len += snprintf(&line[len], sizeof(line) - len, " %6s", "-");
+			}
+		}
+
+		if (row) {
+			shell_print(shell, "%s", line);
+			empty = false;
+		}
+	}
+
+	if (empty) {
+		shell_print(shell, "No results, use 'range run' at each position");
+	}
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_RANGE_H_
+#define THROUGHPUT_RANGE_H_
+
+#include <zephyr/shell/shell.h>
+
+#include "main.h"
+
+/** PHYs of the long range test. */
+enum range_phy {
+	RANGE_PHY_1M,
+	RANGE_PHY_2M,
+	RANGE_PHY_S2,
+	RANGE_PHY_S8,
+	RANGE_PHYS,
+};
+
+/* RSSI bins of the table: RANGE_RSSI_MIN to RANGE_RSSI_MAX in RANGE_RSSI_STEP dB steps; RSSI
+ * outside the range goes to the first or the last bin.
+ */
+#define RANGE_RSSI_MIN	(-100)
+#define RANGE_RSSI_MAX	(-20)
+#define RANGE_RSSI_STEP 5
+
+/** @brief Name of a PHY of the test. */
+const char *range_phy_name(enum range_phy phy);
+
+/**
+ * @brief Add the result of a run to the table, in the bin of its average RSSI.
+ * Runs without RSSI samples are not added.
+ */
+void range_add(enum range_phy phy, const struct test_result *res);
+
+/** @brief Print one line about a run: rate, RSSI and packet errors. */
+void range_result_print(const struct shell *shell, enum range_phy phy,
+			const struct test_result *res);
+
+/** @brief Clear the table. */
+void range_reset(void);
+
+/** @brief Print the rate and packet error rate per PHY and RSSI bin. */
+void range_print(const struct shell *shell);
+
+#endif /* THROUGHPUT_RANGE_H_ */
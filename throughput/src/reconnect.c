@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/shell/shell.h>
+#include <bluetooth/scan.h>
+
+#include "reconnect.h"
+
+#define BURST_TIME   K_MSEC(CONFIG_BT_THROUGHPUT_RECONNECT_BURST)
+#define GIVE_UP_TIME K_SECONDS(CONFIG_BT_THROUGHPUT_RECONNECT_TIMEOUT)
+
+enum phase {
+	/* First link connected, or lost and not seen for too long */
+	PHASE_IDLE,
+	/* Lost; normal scan */
+	PHASE_OPEN,
+	/* Lost; fast scan not started yet */
+	PHASE_ARMED,
+	/* Scanning for the peer with a 100% duty cycle */
+	PHASE_BURST,
+	/* Scanning for the peer with the normal interval and window */
+	PHASE_BACKOFF,
+};
+
+static const char *const phase_name[] = {
+	"idle", "normal scan", "fast scan", "burst", "backoff",
+};
+
+struct time_stats {
+	uint32_t last;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t count;
+};
+
+static struct {
+	enum reconnect_mode mode;
+	enum phase phase;
+	bt_addr_le_t peer;
+	int64_t lost_at;
+	/* Connected again, ready time pending */
+	bool wait_ready;
+	uint32_t burst_hits;
+	uint32_t backoff_hits;
+	uint32_t given_up;
+	struct time_stats connect;
+	struct time_stats ready;
+} rc;
+
+static struct k_spinlock lock;
+static struct bt_le_scan_param normal_scan;
+static struct bt_le_conn_param normal_conn;
+
+static void burst_end_handler(struct k_work *work);
+static void give_up_handler(struct k_work *work);
+static void restore_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(burst_end, burst_end_handler);
+static K_WORK_DELAYABLE_DEFINE(give_up, give_up_handler);
+static K_WORK_DEFINE(restore, restore_handler);
+
+static void time_add(struct time_stats *s, uint32_t ms)
+{
+	s->last = ms;
+	s->min = s->count ? MIN(s->min, ms) : ms;
+	s->max = MAX(s->max, ms);
+	s->sum += ms;
+	s->count++;
+}
+
+static enum phase phase_get(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	enum phase phase = rc.phase;
+
+	k_spin_unlock(&lock, key);
+
+	return phase;
+}
+
+/* Only called from the system work queue while scanning is stopped. */
+static void scan_apply(enum phase phase)
+{
+	struct bt_le_scan_param scan = normal_scan;
+	struct bt_le_conn_param conn = normal_conn;
+	struct bt_scan_init_param init = {
+		.connect_if_match = 1,
+		.scan_param = &scan,
+		.conn_param = &conn,
+	};
+
+	switch (phase) {
+	case PHASE_BURST:
+		scan.window = scan.interval;
+		__fallthrough;
+	case PHASE_BACKOFF:
+		scan.options |= BT_LE_SCAN_OPT_FILTER_ACCEPT_LIST;
+		break;
+	default:
+		break;
+	}
+
+	bt_scan_params_set(&init);
+}
+
+/* Switch the scan to another phase; scanning resumes only if it was running. A connection
+ * being created stops the scan; it is started again with the new parameters if that fails.
+ */
+static void scan_switch(enum phase phase)
+{
+	int err = bt_scan_stop();
+
+	scan_apply(phase);
+	if (phase == PHASE_OPEN || phase == PHASE_IDLE) {
+		bt_le_filter_accept_list_clear();
+	}
+
+	if (!err) {
+		err = bt_scan_start(BT_SCAN_TYPE_SCAN_PASSIVE);
+		if (err) {
+			printk("Scan restart failed (err %d)\n", err);
+		}
+	}
+}
+
+static void burst_end_handler(struct k_work *work)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (rc.phase != PHASE_BURST) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	rc.phase = PHASE_BACKOFF;
+	k_spin_unlock(&lock, key);
+
+	printk("Reconnect burst over, scanning at %u/%u units\n", normal_scan.window,
+	       normal_scan.interval);
+	scan_switch(PHASE_BACKOFF);
+}
+
+static void give_up_handler(struct k_work *work)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (rc.phase != PHASE_BURST && rc.phase != PHASE_BACKOFF) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	rc.phase = PHASE_OPEN;
+	rc.given_up++;
+	k_spin_unlock(&lock, key);
+
+	k_work_cancel_delayable(&burst_end);
+
+	printk("Peer not found in %d s, scanning for any peer\n",
+	       CONFIG_BT_THROUGHPUT_RECONNECT_TIMEOUT);
+	scan_switch(PHASE_OPEN);
+}
+
+static void restore_handler(struct k_work *work)
+{
+	k_work_cancel_delayable(&burst_end);
+	k_work_cancel_delayable(&give_up);
+
+	/* Further links are found with the normal scan. */
+	scan_switch(PHASE_IDLE);
+}
+
+void reconnect_init(const struct bt_le_scan_param *scan_param,
+		    const struct bt_le_conn_param *conn_param)
+{
+	normal_scan = *scan_param;
+	normal_conn = *conn_param;
+}
+
+void reconnect_mode_set(enum reconnect_mode mode)
+{
+	rc.mode = mode;
+}
+
+enum reconnect_mode reconnect_mode_get(void)
+{
+	return rc.mode;
+}
+
+void reconnect_lost(const bt_addr_le_t *peer)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	bt_addr_le_copy(&rc.peer, peer);
+	rc.lost_at = k_uptime_get();
+	rc.wait_ready = false;
+	rc.phase = (rc.mode == RECONNECT_FAST) ? PHASE_ARMED : PHASE_OPEN;
+	k_spin_unlock(&lock, key);
+}
+
+bool reconnect_pending(void)
+{
+	return phase_get() != PHASE_IDLE;
+}
+
+int reconnect_scan_start(void)
+{
+	char addr[BT_ADDR_LE_STR_LEN];
+	enum phase phase = phase_get();
+	k_spinlock_key_t key;
+	int err;
+
+	if (phase != PHASE_ARMED && phase != PHASE_BURST && phase != PHASE_BACKOFF) {
+		return -EAGAIN;
+	}
+
+	/* The accept list can't be changed while a scan uses it. */
+	bt_scan_stop();
+
+	if (phase == PHASE_ARMED) {
+		bt_le_filter_accept_list_clear();
+		err = bt_le_filter_accept_list_add(&rc.peer);
+
+		key = k_spin_lock(&lock);
+		if (rc.phase == PHASE_ARMED) {
+			rc.phase = err ? PHASE_OPEN : PHASE_BURST;
+		}
+		phase = rc.phase;
+		k_spin_unlock(&lock, key);
+
+		if (err) {
+			printk("Filter accept list not available (err %d)\n", err);
+			scan_apply(PHASE_OPEN);
+			return -EAGAIN;
+		}
+
+		k_work_schedule(&burst_end, BURST_TIME);
+		k_work_schedule(&give_up, GIVE_UP_TIME);
+	}
+
+	scan_apply(phase);
+
+	bt_addr_le_to_str(&rc.peer, addr, sizeof(addr));
+	err = bt_scan_start(BT_SCAN_TYPE_SCAN_PASSIVE);
+	printk("Start scanning for %s (%s): %d\n", addr, phase_name[phase], err);
+
+	return err;
+}
+
+void reconnect_connected(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	enum phase phase = rc.phase;
+	uint32_t ms;
+
+	if (phase == PHASE_IDLE) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	ms = (uint32_t)(k_uptime_get() - rc.lost_at);
+	time_add(&rc.connect, ms);
+	if (phase == PHASE_BURST) {
+		rc.burst_hits++;
+	} else if (phase == PHASE_BACKOFF) {
+		rc.backoff_hits++;
+	}
+
+	rc.phase = PHASE_IDLE;
+	rc.wait_ready = true;
+	k_spin_unlock(&lock, key);
+
+	printk("Reconnected in %u ms (%s)\n", ms, phase_name[phase]);
+
+	if (phase != PHASE_OPEN) {
+		k_work_submit(&restore);
+	}
+}
+
+void reconnect_ready(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (rc.wait_ready) {
+		time_add(&rc.ready, (uint32_t)(k_uptime_get() - rc.lost_at));
+		rc.wait_ready = false;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void reconnect_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(&rc.connect, 0, sizeof(rc.connect));
+	memset(&rc.ready, 0, sizeof(rc.ready));
+	rc.burst_hits = 0;
+	rc.backoff_hits = 0;
+	rc.given_up = 0;
+	k_spin_unlock(&lock, key);
+}
+
+static void time_print(const struct shell *shell, const char *name, const struct time_stats *s)
+{
+	if (!s->count) {
+		shell_print(shell, "%-8s %8s", name, "-");
+		return;
+	}
+
+	shell_print(shell, "%-8s %8u %8u %8llu %8u", name, s->last, s->min, s->sum / s->count,
+		    s->max);
+}
+
+void reconnect_print(const struct shell *shell)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	typeof(rc) copy = rc;
+
+	k_spin_unlock(&lock, key);
+
+	shell_print(shell, "Reconnect mode: %s (burst %d ms, give up after %d s)",
+		    copy.mode == RECONNECT_FAST ? "fast" : "normal",
+		    CONFIG_BT_THROUGHPUT_RECONNECT_BURST, CONFIG_BT_THROUGHPUT_RECONNECT_TIMEOUT);
+	shell_print(shell, "State: %s", phase_name[copy.phase]);
+	shell_print(shell, "Reconnects: %u (burst %u, backoff %u), peer not found: %u",
+		    copy.connect.count, copy.burst_hits, copy.backoff_hits, copy.given_up);
+	shell_print(shell, "Time from link loss (ms)");
+	shell_print(shell, "%-8s %8s %8s %8s %8s", "", "last", "min", "avg", "max");
+	time_print(shell, "connect", &copy.connect);
+	time_print(shell, "ready", &copy.ready);
+}
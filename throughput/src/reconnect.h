@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_RECONNECT_H_
+#define THROUGHPUT_RECONNECT_H_
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/shell/shell.h>
+
+/** How the central looks for the peer of the first link after the link is lost. */
+enum reconnect_mode {
+	/* Scan for any peer with the normal scan parameters */
+	RECONNECT_NORMAL,
+	/* Scan for the lost peer only (filter accept list), continuously for a burst,
+	 * then with the normal scan parameters until it is found or the search times out.
+	 */
+	RECONNECT_FAST,
+};
+
+/** @brief Scan and connection parameters used outside a fast reconnect. */
+void reconnect_init(const struct bt_le_scan_param *scan_param,
+		    const struct bt_le_conn_param *conn_param);
+
+void reconnect_mode_set(enum reconnect_mode mode);
+
+enum reconnect_mode reconnect_mode_get(void);
+
+/** @brief The first link was lost; starts the reconnect timing. */
+void reconnect_lost(const bt_addr_le_t *peer);
+
+/** @brief true from the loss of the first link until it is connected again. */
+bool reconnect_pending(void);
+
+/**
+ * @brief Start scanning for the lost peer (fast mode).
+ *
+ * @return -EAGAIN if the normal scan is to be used, 0 or a scan error otherwise.
+ */
+int reconnect_scan_start(void);
+
+/** @brief The first link is connected again. */
+void reconnect_connected(void);
+
+/** @brief The first link is ready for a test again. */
+void reconnect_ready(void);
+
+/** @brief Clear the statistics. */
+void reconnect_reset(void);
+
+/** @brief Print the time to reconnect. */
+void reconnect_print(const struct shell *shell);
+
+#endif /* THROUGHPUT_RECONNECT_H_ */
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/gap.h>
+
+#include "report.h"
+
+/* Integer fields that may be missing; null in JSON, empty in CSV. */
+#define OPT_LEN sizeof("-2147483648")
+
+static const char *phy_name(uint8_t phy)
+{
+	switch (phy) {
+	case BT_GAP_LE_PHY_1M:
+		return "1M";
+	case BT_GAP_LE_PHY_2M:
+		return "2M";
+	case BT_GAP_LE_PHY_CODED:
+		return "coded";
+	default:
+		return "unknown";
+	}
+}
+
+static void opt_str(char *buf, bool valid, int32_t val, const char *none)
+{
+	if (valid) {
+		snprintk(buf, OPT_LEN, "%d", val);
+	} else {
+		snprintk(buf, OPT_LEN, "%s", none);
+	}
+}
+
+/* Counters use the full uint32_t range. */
+static void opt_str_u(char *buf, bool valid, uint32_t val, const char *none)
+{
+	if (valid) {
+		snprintk(buf, OPT_LEN, "%u", val);
+	} else {
+		snprintk(buf, OPT_LEN, "%s", none);
+	}
+}
+
+const char *report_format_name(enum output_format format)
+{
+	switch (format) {
+	case OUTPUT_JSON:
+		return "json";
+	case OUTPUT_CSV:
+		return "csv";
+	default:
+		return "text";
+	}
+}
+
+void report_print(enum output_format format, const struct run_record *rec)
+{
+	const char *none = (format == OUTPUT_JSON) ? "null" : "";
+	char tx_power[OPT_LEN];
+	char peer_bytes[OPT_LEN];
+	char peer_kbps[OPT_LEN];
+	char crc_errors[OPT_LEN];
+	char jitter_us[OPT_LEN];
+	char rx_hwm[OPT_LEN];
+	char peer_rssi[OPT_LEN];
+
+	if (format == OUTPUT_TEXT) {
+		return;
+	}
+
+	opt_str(tx_power, rec->tx_power_valid, rec->tx_power, none);
+	opt_str_u(peer_bytes, rec->peer_valid, rec->peer_bytes, none);
+	opt_str_u(peer_kbps, rec->peer_valid, rec->peer_kbps, none);
+	opt_str_u(crc_errors, rec->ext_valid, rec->peer_crc_errors, none);
+	opt_str_u(jitter_us, rec->ext_valid, rec->peer_jitter_us, none);
+	opt_str_u(rx_hwm, rec->ext_valid, rec->peer_rx_hwm, none);
+	opt_str(peer_rssi, rec->peer_rssi_valid, rec->peer_rssi, none);
+
+	if (format == OUTPUT_JSON) {
+		printk("{\"board\":\"%s\",\"version\":\"%s\",\"transport\":\"%s\","
+		       "\"phy\":\"%s\",\"data_len\":%u,\"interval\":%u,\"mtu\":%u,\"write_len\":%u,"
+		       "\"tx_power\":%s,\"duration_ms\":%u,\"bytes\":%u,\"kbps\":%u,"
+		       "\"peer_bytes\":%s,\"peer_kbps\":%s,\"peer_crc_errors\":%s,"
+		       "\"peer_jitter_us\":%s,\"peer_rx_hwm\":%s,\"peer_rssi\":%s}\n",
+		       CONFIG_BOARD, rec->version, rec->transport, phy_name(rec->phy),
+		       rec->data_len, rec->interval, rec->mtu, rec->write_len, tx_power,
+		       rec->duration_ms, rec->bytes, rec->kbps, peer_bytes, peer_kbps, crc_errors,
+		       jitter_us, rx_hwm, peer_rssi);
+		return;
+	}
+
+	printk("board,version,transport,phy,data_len,interval,mtu,write_len,tx_power,duration_ms,"
+	       "bytes,kbps,peer_bytes,peer_kbps,peer_crc_errors,peer_jitter_us,peer_rx_hwm,"
+	       "peer_rssi\n");
+	printk("%s,%s,%s,%s,%u,%u,%u,%u,%s,%u,%u,%u,%s,%s,%s,%s,%s,%s\n", CONFIG_BOARD,
+	       rec->version, rec->transport, phy_name(rec->phy), rec->data_len, rec->interval,
+	       rec->mtu, rec->write_len, tx_power, rec->duration_ms, rec->bytes, rec->kbps,
+	       peer_bytes, peer_kbps, crc_errors, jitter_us, rx_hwm, peer_rssi);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_REPORT_H_
+#define THROUGHPUT_REPORT_H_
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+/** Format of the result record that ends a run. */
+enum output_format {
+	OUTPUT_TEXT = 0,
+	OUTPUT_JSON,
+	OUTPUT_CSV,
+};
+
+/** Result of a run; the record fields don't change with the text output. */
+struct run_record {
+	const char *version;
+	const char *transport;
+	/* BT_GAP_LE_PHY_* of the tester TX */
+	uint8_t phy;
+	uint16_t data_len;
+	/* Connection interval in 1.25 ms units */
+	uint16_t interval;
+	uint16_t mtu;
+	/* Payload of each write or SDU */
+	uint16_t write_len;
+	bool tx_power_valid;
+	int8_t tx_power;
+	uint32_t duration_ms;
+	uint32_t bytes;
+	uint32_t kbps;
+	/* Metrics of the peer, valid if peer_valid */
+	bool peer_valid;
+	uint32_t peer_bytes;
+	uint32_t peer_kbps;
+	/* Extended metrics of the peer, valid if ext_valid */
+	bool ext_valid;
+	uint32_t peer_crc_errors;
+	uint32_t peer_jitter_us;
+	uint16_t peer_rx_hwm;
+	/* Average connection RSSI at the peer, valid if peer_rssi_valid */
+	bool peer_rssi_valid;
+	int8_t peer_rssi;
+};
+
+/** @brief Name of the format for the shell. */
+const char *report_format_name(enum output_format format);
+
+/**
+ * @brief Print the record of a run. OUTPUT_TEXT prints nothing; JSON is a single line
+ * and CSV a header line followed by the record.
+ */
+void report_print(enum output_format format, const struct run_record *rec);
+
+#endif /* THROUGHPUT_REPORT_H_ */
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+#include "main.h"
+#include "rssi.h"
+
+#define RSSI_STACK_SIZE 1024
+#define RSSI_PRIORITY	K_PRIO_PREEMPT(10)
+#define RSSI_BINS	(RSSI_HIST_MAX - RSSI_HIST_MIN + 1)
+
+/* The HCI round trip blocks, so it gets its own queue instead of the system work queue. */
+static K_THREAD_STACK_DEFINE(rssi_stack, RSSI_STACK_SIZE);
+static struct k_work_q rssi_work_q;
+
+static void rssi_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(rssi_work, rssi_work_handler);
+
+/* Latest value; RSSI_NONE until the first read */
+#define RSSI_NONE INT32_MIN
+static atomic_t rssi_last = ATOMIC_INIT(RSSI_NONE);
+static atomic_t running;
+
+static struct k_spinlock lock;
+static uint32_t bins[RSSI_BINS];
+
+static void rssi_work_handler(struct k_work *work)
+{
+	k_spinlock_key_t key;
+	int8_t rssi;
+
+	if (!atomic_get(&running)) {
+		return;
+	}
+
+	if (read_conn_rssi(&rssi) == 0) {
+		atomic_set(&rssi_last, rssi);
+
+		key = k_spin_lock(&lock);
+		bins[CLAMP(rssi, RSSI_HIST_MIN, RSSI_HIST_MAX) - RSSI_HIST_MIN]++;
+		k_spin_unlock(&lock, key);
+	}
+
+	k_work_reschedule_for_queue(&rssi_work_q, &rssi_work,
+				    K_MSEC(CONFIG_BT_THROUGHPUT_RSSI_PERIOD));
+}
+
+static int rssi_init(void)
+{
+	k_work_queue_start(&rssi_work_q, rssi_stack, K_THREAD_STACK_SIZEOF(rssi_stack),
+			   RSSI_PRIORITY, NULL);
+	k_thread_name_set(&rssi_work_q.thread, "rssi");
+
+	return 0;
+}
+
+SYS_INIT(rssi_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+void rssi_monitor_start(void)
+{
+	atomic_set(&rssi_last, RSSI_NONE);
+	rssi_hist_reset();
+	atomic_set(&running, 1);
+	k_work_reschedule_for_queue(&rssi_work_q, &rssi_work, K_NO_WAIT);
+}
+
+void rssi_monitor_stop(void)
+{
+	atomic_set(&running, 0);
+	k_work_cancel_delayable(&rssi_work);
+	atomic_set(&rssi_last, RSSI_NONE);
+}
+
+int rssi_cached(int8_t *rssi)
+{
+	atomic_val_t val = atomic_get(&rssi_last);
+
+	if (val == RSSI_NONE) {
+		return -ENODATA;
+	}
+
+	*rssi = (int8_t)val;
+
+	return 0;
+}
+
+void rssi_hist_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(bins, 0, sizeof(bins));
+	k_spin_unlock(&lock, key);
+}
+
+static int summarize(const uint32_t *hist, struct rssi_summary *summary)
+{
+	uint32_t seen = 0;
+	int32_t sum = 0;
+
+	memset(summary, 0, sizeof(*summary));
+
+	for (int i = 0; i < RSSI_BINS; i++) {
+		if (!hist[i]) {
+			continue;
+		}
+
+		if (!summary->count) {
+			summary->min = i + RSSI_HIST_MIN;
+		}
+
+		summary->max = i + RSSI_HIST_MIN;
+		summary->count += hist[i];
+		sum += (int32_t)hist[i] * (i + RSSI_HIST_MIN);
+	}
+
+	if (!summary->count) {
+		return -ENODATA;
+	}
+
+	summary->avg = sum / (int32_t)summary->count;
+
+	for (int i = 0; i < RSSI_BINS; i++) {
+		seen += hist[i];
+		if (seen * 2 >= summary->count) {
+			summary->median = i + RSSI_HIST_MIN;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int rssi_hist_summary(struct rssi_summary *summary)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	int err = summarize(bins, summary);
+
+	k_spin_unlock(&lock, key);
+
+	return err;
+}
+
+void rssi_hist_print(const struct shell *shell)
+{
+	static uint32_t copy[RSSI_BINS];
+	struct rssi_summary summary;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	memcpy(copy, bins, sizeof(copy));
+	k_spin_unlock(&lock, key);
+
+	if (summarize(copy, &summary)) {
+		shell_print(shell, "No RSSI samples");
+		return;
+	}
+
+	shell_print(shell, "RSSI: %u samples, min %d avg %d median %d max %d dBm", summary.count,
+		    summary.min, summary.avg, summary.median, summary.max);
+
+	for (int i = 0; i < RSSI_BINS; i++) {
+		if (copy[i]) {
+			shell_print(shell, "%4d dBm: %u", i + RSSI_HIST_MIN, copy[i]);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_RSSI_H_
+#define THROUGHPUT_RSSI_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+#define RSSI_HIST_MIN (-127)
+#define RSSI_HIST_MAX 20
+
+/**
+ * @brief Read the connection RSSI every CONFIG_BT_THROUGHPUT_RSSI_PERIOD ms
+ * on a background work queue. Clears the cache and the histogram.
+ */
+void rssi_monitor_start(void);
+
+/** @brief Stop reading; the histogram is kept. */
+void rssi_monitor_stop(void);
+
+/**
+ * @brief Latest RSSI read by the monitor. Doesn't access the controller.
+ *
+ * @retval 0 on success, -ENODATA if nothing was read yet.
+ */
+int rssi_cached(int8_t *rssi);
+
+/** Summary of the histogram. */
+struct rssi_summary {
+	uint32_t count;
+	int8_t min;
+	int8_t avg;
+	int8_t median;
+	int8_t max;
+};
+
+/** @brief Clear the histogram (e.g. at the start of a run). */
+void rssi_hist_reset(void);
+
+/**
+ * @brief Summarize the histogram.
+ *
+ * @retval 0 on success, -ENODATA if there are no samples.
+ */
+int rssi_hist_summary(struct rssi_summary *sum);
+
+/** @brief Print min, avg, median, max and the non-empty histogram bins. */
+void rssi_hist_print(const struct shell *shell);
+
+#endif /* THROUGHPUT_RSSI_H_ */
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "rx_metrics.h"
+#include "rssi.h"
+
+#define WINDOW_MS CONFIG_BT_THROUGHPUT_SAMPLE_WINDOW
+/* Packets closer than this were queued in the host and are handled back to back */
+#define BURST_US  100
+
+static struct {
+	uint32_t packets;
+	uint32_t bytes;
+	uint32_t crc_errors;
+	/* Jitter estimate in 1/16 us (RFC 3550 fixed point) */
+	uint32_t jitter;
+	/* Longest burst of packets handled back to back */
+	uint16_t burst_hwm;
+	uint16_t burst;
+	/* Most receive buffers in use, when the transport reports them */
+	uint16_t buffers_hwm;
+	uint64_t last_arrival;
+	uint32_t last_gap_us;
+	uint32_t window_bytes;
+	uint32_t windows[EXT_SVC_METRICS_WINDOWS];
+	uint8_t window_next;
+	uint32_t arrival[EXT_SVC_METRICS_ARRIVAL_BUCKETS];
+} rx;
+
+static struct k_spinlock lock;
+
+static void window_expiry(struct k_timer *timer)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	rx.windows[rx.window_next] = rx.window_bytes;
+	rx.window_next = (rx.window_next + 1) % ARRAY_SIZE(rx.windows);
+	rx.window_bytes = 0;
+	k_spin_unlock(&lock, key);
+}
+
+static K_TIMER_DEFINE(window_timer, window_expiry, NULL);
+
+static uint8_t arrival_bucket(uint32_t gap_us)
+{
+	uint8_t bucket = 0;
+
+	while (bucket < EXT_SVC_METRICS_ARRIVAL_BUCKETS - 1 &&
+	       gap_us >= ((uint32_t)EXT_SVC_METRICS_ARRIVAL_US << bucket)) {
+		bucket++;
+	}
+
+	return bucket;
+}
+
+void rx_metrics_reset(void)
+{
+	k_spinlock_key_t key;
+
+	k_timer_stop(&window_timer);
+	rssi_hist_reset();
+
+	key = k_spin_lock(&lock);
+	memset(&rx, 0, sizeof(rx));
+	k_spin_unlock(&lock, key);
+}
+
+void rx_metrics_packet(uint16_t len)
+{
+	uint64_t now = k_cycle_get_64();
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	uint32_t gap_us;
+	int32_t delta;
+
+	if (rx.packets == 0) {
+		/* Windows are aligned to the first packet. */
+		k_timer_start(&window_timer, K_MSEC(WINDOW_MS), K_MSEC(WINDOW_MS));
+	} else {
+		gap_us = (uint32_t)k_cyc_to_us_floor64(now - rx.last_arrival);
+		rx.arrival[arrival_bucket(gap_us)]++;
+
+		rx.burst = (gap_us < BURST_US) ? rx.burst + 1 : 1;
+		rx.burst_hwm = MAX(rx.burst_hwm, rx.burst);
+
+		/* J += (|D| - J) / 16, D being the change of the inter-arrival time */
+		if (rx.packets > 1) {
+			delta = (int32_t)(gap_us - rx.last_gap_us);
+			rx.jitter += (uint32_t)abs(delta) - ((rx.jitter + 8) >> 4);
+		}
+		rx.last_gap_us = gap_us;
+	}
+
+	rx.last_arrival = now;
+	rx.packets++;
+	rx.bytes += len;
+	rx.window_bytes += len;
+	k_spin_unlock(&lock, key);
+}
+
+void rx_metrics_crc_error(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	rx.crc_errors++;
+	k_spin_unlock(&lock, key);
+}
+
+void rx_metrics_buffers(uint16_t in_use)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	rx.buffers_hwm = MAX(rx.buffers_hwm, in_use);
+	k_spin_unlock(&lock, key);
+}
+
+void rx_metrics_get(struct ext_svc_metrics *met)
+{
+	struct rssi_summary rssi;
+	k_spinlock_key_t key;
+	uint8_t idx;
+
+	/* The RSSI monitor of the first link counts since the last reset too. */
+	met->rssi = rssi_hist_summary(&rssi) ? EXT_SVC_METRICS_RSSI_NONE : rssi.avg;
+
+	key = k_spin_lock(&lock);
+
+	met->packets = sys_cpu_to_le32(rx.packets);
+	met->bytes = sys_cpu_to_le32(rx.bytes);
+	met->crc_errors = sys_cpu_to_le32(rx.crc_errors);
+	met->jitter_us = sys_cpu_to_le32(rx.jitter >> 4);
+	met->rx_hwm = sys_cpu_to_le16(rx.buffers_hwm ? rx.buffers_hwm : rx.burst_hwm);
+	met->window_ms = sys_cpu_to_le16(WINDOW_MS);
+
+	for (uint8_t i = 0; i < EXT_SVC_METRICS_WINDOWS; i++) {
+		idx = (rx.window_next + EXT_SVC_METRICS_WINDOWS - 1 - i) % EXT_SVC_METRICS_WINDOWS;
+		met->window_kbps[i] = sys_cpu_to_le32(rx.windows[idx] * 8 / WINDOW_MS);
+	}
+
+	for (uint8_t i = 0; i < EXT_SVC_METRICS_ARRIVAL_BUCKETS; i++) {
+		met->arrival[i] = sys_cpu_to_le32(rx.arrival[i]);
+	}
+
+	k_spin_unlock(&lock, key);
+}
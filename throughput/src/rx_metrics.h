@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_RX_METRICS_H_
+#define THROUGHPUT_RX_METRICS_H_
+
+#include <zephyr/types.h>
+
+#include "ext_svc.h"
+
+/** @brief Clear the receiver metrics (the tester starts a run). */
+void rx_metrics_reset(void);
+
+/** @brief Account a received packet. */
+void rx_metrics_packet(uint16_t len);
+
+/** @brief Account a verified packet with a bad CRC. */
+void rx_metrics_crc_error(void);
+
+/** @brief Report the number of receive buffers in use (L2CAP). */
+void rx_metrics_buffers(uint16_t in_use);
+
+/** @brief Current metrics in the characteristic (little endian) format. */
+void rx_metrics_get(struct ext_svc_metrics *met);
+
+#endif /* THROUGHPUT_RX_METRICS_H_ */
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/shell/shell.h>
+
+#include "sampler.h"
+
+struct sample {
+	/* End of the window since the start of the run */
+	uint32_t t_us;
+	uint32_t bytes;
+};
+
+static struct {
+	const atomic_t *counters[CONFIG_BT_THROUGHPUT_MAX_LINKS];
+	size_t count;
+	uint64_t start;
+	uint32_t last;
+	/* Total number of windows recorded; the ring holds the newest ones. */
+	uint32_t recorded;
+	struct sample ring[CONFIG_BT_THROUGHPUT_SAMPLE_COUNT];
+} sampler;
+
+static struct k_spinlock lock;
+
+static void sample_take(void)
+{
+	struct sample *s = &sampler.ring[sampler.recorded % ARRAY_SIZE(sampler.ring)];
+	uint32_t total = 0;
+
+	for (size_t i = 0; i < sampler.count; i++) {
+		total += atomic_get(sampler.counters[i]);
+	}
+
+	s->t_us = (uint32_t)k_cyc_to_us_floor64(k_cycle_get_64() - sampler.start);
+	s->bytes = total - sampler.last;
+	sampler.last = total;
+	sampler.recorded++;
+}
+
+static void sample_timer_expiry(struct k_timer *timer)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	sample_take();
+	k_spin_unlock(&lock, key);
+}
+
+static K_TIMER_DEFINE(sample_timer, sample_timer_expiry, NULL);
+
+void sampler_start(const atomic_t *const *counters, size_t count)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	sampler.count = MIN(count, ARRAY_SIZE(sampler.counters));
+	sampler.last = 0;
+	for (size_t i = 0; i < sampler.count; i++) {
+		sampler.counters[i] = counters[i];
+		sampler.last += atomic_get(counters[i]);
+	}
+
+	sampler.recorded = 0;
+	sampler.start = k_cycle_get_64();
+	k_spin_unlock(&lock, key);
+
+	k_timer_start(&sample_timer, K_MSEC(CONFIG_BT_THROUGHPUT_SAMPLE_WINDOW),
+		      K_MSEC(CONFIG_BT_THROUGHPUT_SAMPLE_WINDOW));
+}
+
+void sampler_stop(void)
+{
+	k_spinlock_key_t key;
+
+	k_timer_stop(&sample_timer);
+
+	key = k_spin_lock(&lock);
+	sample_take();
+	sampler.count = 0;
+	k_spin_unlock(&lock, key);
+}
+
+void sampler_dump(const struct shell *shell)
+{
+	uint32_t first;
+	uint32_t prev_us;
+	uint32_t dt_us;
+	struct sample *s;
+
+	if (sampler.recorded == 0) {
+		shell_error(shell, "No samples, run the test first");
+		return;
+	}
+
+	if (sampler.count) {
+		shell_error(shell, "Test is running");
+		return;
+	}
+
+	first = sampler.recorded > ARRAY_SIZE(sampler.ring) ?
+			sampler.recorded - ARRAY_SIZE(sampler.ring) : 0;
+	if (first) {
+		shell_warn(shell, "%u oldest samples dropped", first);
+	}
+
+	shell_print(shell, "sample,t_ms,bytes,kbps");
+
+	/* The window before the first kept sample is assumed to be nominal. */
+	prev_us = 0;
+	if (first) {
+		prev_us = sampler.ring[first % ARRAY_SIZE(sampler.ring)].t_us -
+			  CONFIG_BT_THROUGHPUT_SAMPLE_WINDOW * USEC_PER_MSEC;
+	}
+
+	for (uint32_t i = first; i < sampler.recorded; i++) {
+		s = &sampler.ring[i % ARRAY_SIZE(sampler.ring)];
+		dt_us = MAX(1, s->t_us - prev_us);
+		prev_us = s->t_us;
+
+		shell_print(shell, "%u,%u.%03u,%u,%llu", i, s->t_us / 1000, s->t_us % 1000,
+			    s->bytes, (uint64_t)s->bytes * 8 * 1000 / dt_us);
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_SAMPLER_H_
+#define THROUGHPUT_SAMPLER_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/atomic.h>
+
+/**
+ * @brief Start recording the bytes counted by the given counters once per
+ * CONFIG_BT_THROUGHPUT_SAMPLE_WINDOW. The samples of the previous run are cleared.
+ *
+ * @param counters Byte counters (e.g. acknowledged bytes of each TX window), summed.
+ * @param count    Number of counters, at most CONFIG_BT_THROUGHPUT_MAX_LINKS.
+ */
+void sampler_start(const atomic_t *const *counters, size_t count);
+
+/** @brief Stop recording; the last partial window is added as a sample. */
+void sampler_stop(void);
+
+/** @brief Print the samples as CSV: sample, end time (ms), bytes and rate of the window. */
+void sampler_dump(const struct shell *shell);
+
+#endif /* THROUGHPUT_SAMPLER_H_ */
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+#include "sched.h"
+#include "payload.h"
+
+#define SCHED_WAIT_MAX K_MSEC(100)
+#define SCHED_DRAIN_TIMEOUT K_SECONDS(5)
+
+/* Given by every completion; the scheduler waits on it when all windows are full. */
+static K_SEM_DEFINE(sched_kick, 0, 1);
+
+/* Every link gets one credit and a share of the rest, so the shares add up to at most
+ * TX_WINDOW_SIZE (unless there are more links than credits).
+ */
+static uint8_t window_share(struct link *const *set, size_t count, enum sched_policy policy,
+			    size_t i)
+{
+	uint32_t spare = (TX_WINDOW_SIZE > count) ? TX_WINDOW_SIZE - count : 0;
+	uint32_t total = 0;
+
+	if (policy != SCHED_WEIGHTED) {
+		return 1 + spare / count;
+	}
+
+	for (size_t n = 0; n < count; n++) {
+		total += set[n]->weight;
+	}
+
+	return 1 + (spare * set[i]->weight) / total;
+}
+
+void sched_prepare(struct link *const *set, size_t count, enum sched_policy policy)
+{
+	for (size_t i = 0; i < count; i++) {
+		tx_window_init(&set[i]->win, window_share(set, count, policy, i));
+		set[i]->win.kick = &sched_kick;
+	}
+
+	k_sem_reset(&sched_kick);
+}
+
+int sched_run(struct link *const *set, size_t count, enum sched_policy policy, uint16_t len,
+	      uint32_t duration_ms)
+{
+	k_timepoint_t end = sys_timepoint_calc(K_MSEC(duration_ms));
+	struct net_buf *buf;
+	struct link *lnk;
+	size_t next = 0;
+	bool progress;
+	uint8_t quota;
+	int err = 0;
+
+	while (!err && !sys_timepoint_expired(end)) {
+		progress = false;
+
+		for (size_t n = 0; n < count && !err; n++) {
+			lnk = set[(next + n) % count];
+			quota = (policy == SCHED_WEIGHTED) ? lnk->weight : 1;
+
+			while (quota-- && tx_window_credits(&lnk->win)) {
+				buf = payload_get(len, K_NO_WAIT);
+				if (!buf) {
+					break;
+				}
+
+				/* Only this thread takes credits, so this doesn't block. */
+				err = tx_engine_write(&lnk->win, &lnk->throughput, buf, K_NO_WAIT);
+				if (err) {
+					printk("Link %p write failed (err %d)\n", lnk->conn, err);
+					break;
+				}
+
+				progress = true;
+			}
+		}
+
+		/* Start the next round with the next link. */
+		next = (next + 1) % count;
+
+		if (!progress) {
+			k_sem_take(&sched_kick, SCHED_WAIT_MAX);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (tx_window_drain(&set[i]->win, SCHED_DRAIN_TIMEOUT)) {
+			printk("Link %p: %u writes still pending\n", set[i]->conn,
+			       tx_window_in_flight(&set[i]->win));
+		}
+		set[i]->win.kick = NULL;
+	}
+
+	return err;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_SCHED_H_
+#define THROUGHPUT_SCHED_H_
+
+#include <zephyr/kernel.h>
+
+#include "link.h"
+
+#define SCHED_WEIGHT_MAX 16
+
+/** How the TX credits are shared between links. */
+enum sched_policy {
+	/* Equal window per link, one write per link per round */
+	SCHED_ROUND_ROBIN = 0,
+	/* Window and writes per round in proportion to the link weight */
+	SCHED_WEIGHTED,
+};
+
+/**
+ * @brief Split the TX window between the links and reset their byte counters.
+ * Must be called before sched_run().
+ */
+void sched_prepare(struct link *const *set, size_t count, enum sched_policy policy);
+
+/**
+ * @brief Stream to several links at once.
+ * The TX window is split between the links and the links are served in turn,
+ * so one slow link can't hold back the others.
+ * Bytes sent on each link are accounted in its window.
+ *
+ * @param set         Links to send on.
+ * @param count       Number of links.
+ * @param policy      Credit sharing policy.
+ * @param len         Write length.
+ * @param duration_ms Test duration.
+ *
+ * @retval 0 on success, otherwise the first write error.
+ */
+int sched_run(struct link *const *set, size_t count, enum sched_policy policy, uint16_t len,
+	      uint32_t duration_ms);
+
+#endif /* THROUGHPUT_SCHED_H_ */
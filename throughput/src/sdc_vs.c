@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/hci.h>
+
+#include "sdc_vs.h"
+
+int sdc_vs_conn_event_extend(bool enable)
+{
+	struct sdc_vs_cp_conn_event_extend *cp;
+	struct net_buf *buf;
+
+	buf = bt_hci_cmd_create(SDC_VS_OP_CONN_EVENT_EXTEND, sizeof(*cp));
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	cp->enable = enable;
+
+	return bt_hci_cmd_send_sync(SDC_VS_OP_CONN_EVENT_EXTEND, buf, NULL);
+}
+
+int sdc_vs_qos_conn_event_report_enable(bool enable)
+{
+	struct sdc_vs_cp_qos_conn_event_report_enable *cp;
+	struct net_buf *buf;
+
+	buf = bt_hci_cmd_create(SDC_VS_OP_QOS_CONN_EVENT_REPORT_ENABLE, sizeof(*cp));
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	cp->enable = enable;
+
+	return bt_hci_cmd_send_sync(SDC_VS_OP_QOS_CONN_EVENT_REPORT_ENABLE, buf, NULL);
+}
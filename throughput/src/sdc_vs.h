@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_SDC_VS_H_
+#define THROUGHPUT_SDC_VS_H_
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+#include <zephyr/toolchain.h>
+
+/* SoftDevice Controller vendor specific commands.
+ * The controller runs on the network core, so the controller headers
+ * aren't available to the application and the commands are defined here.
+ * Other controllers reject them with "Unknown HCI Command".
+ */
+#define SDC_VS_OP_CONN_EVENT_EXTEND		 0xfd03
+#define SDC_VS_OP_QOS_CONN_EVENT_REPORT_ENABLE	 0xfd04
+
+/* Vendor specific event subevent codes */
+#define SDC_VS_SUBEVENT_QOS_CONN_EVENT_REPORT	 0x80
+
+struct sdc_vs_cp_conn_event_extend {
+	uint8_t enable;
+} __packed;
+
+struct sdc_vs_cp_qos_conn_event_report_enable {
+	uint8_t enable;
+} __packed;
+
+/* Sent after every connection event while enabled */
+struct sdc_vs_evt_qos_conn_event_report {
+	uint16_t conn_handle;
+	uint16_t event_counter;
+	uint32_t anchor_point;
+	uint8_t channel_index;
+	/* Packets sent, new and retransmitted */
+	uint8_t tx_packet_count;
+	/* Sent packets acknowledged by the peer */
+	uint8_t tx_ack_count;
+	uint8_t rx_packet_count;
+	uint8_t crc_error_count;
+	/* Packets from the peer that NAKed the last packet sent */
+	uint8_t nak_count;
+} __packed;
+
+/**
+ * @brief Let the controller extend connection events while there is data to send.
+ * Applies to all connections.
+ */
+int sdc_vs_conn_event_extend(bool enable);
+
+/**
+ * @brief Send a QoS connection event report after every connection event.
+ * Applies to all connections.
+ */
+int sdc_vs_qos_conn_event_report_enable(bool enable);
+
+#endif /* THROUGHPUT_SDC_VS_H_ */
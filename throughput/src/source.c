@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_FLASH_MAP)
+#include <zephyr/storage/flash_map.h>
+#if FIXED_PARTITION_EXISTS(storage_partition)
+#define SOURCE_FLASH_ID FIXED_PARTITION_ID(storage_partition)
+#endif
+#endif
+
+#include "source.h"
+#include "payload.h"
+
+/** A data source. */
+struct source_ops {
+	const char *name;
+	/* Check that the source can be used; NULL if it always can */
+	int (*open)(void);
+	/* Read len bytes at offset of the (repeated) source; NULL if the ring is prefilled */
+	int (*read)(uint8_t *dst, size_t len, uint32_t offset);
+	/* Called at the start of a run; NULL if there is nothing to do */
+	int (*rewind)(void);
+};
+
+static uint8_t buffer[CONFIG_BT_THROUGHPUT_SOURCE_BUF_SIZE];
+static size_t buffer_len;
+
+static enum source_type selected = SOURCE_PATTERN;
+static uint32_t offset;
+
+static int pattern_rewind(void)
+{
+	/* Other sources and verified packets overwrite the ring. */
+	payload_init();
+
+	return 0;
+}
+
+#if defined(SOURCE_FLASH_ID)
+static const struct flash_area *flash_fa;
+
+static int flash_open(void)
+{
+	return flash_fa ? 0 : flash_area_open(SOURCE_FLASH_ID, &flash_fa);
+}
+
+static int flash_read(uint8_t *dst, size_t len, uint32_t pos)
+{
+	size_t chunk;
+	int err;
+
+	while (len) {
+		pos %= flash_fa->fa_size;
+		chunk = MIN(len, flash_fa->fa_size - pos);
+
+		err = flash_area_read(flash_fa, pos, dst, chunk);
+		if (err) {
+			return err;
+		}
+
+		dst += chunk;
+		pos += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+#else
+static int flash_open(void)
+{
+	return -ENOTSUP;
+}
+#define flash_read NULL
+#endif
+
+static int buffer_open(void)
+{
+	return buffer_len ? 0 : -ENODATA;
+}
+
+static int buffer_read(uint8_t *dst, size_t len, uint32_t pos)
+{
+	size_t chunk;
+
+	while (len) {
+		pos %= buffer_len;
+		chunk = MIN(len, buffer_len - pos);
+		memcpy(dst, &buffer[pos], chunk);
+
+		dst += chunk;
+		pos += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+static const struct source_ops sources[SOURCE_COUNT] = {
+	[SOURCE_PATTERN] = { .name = "pattern", .rewind = pattern_rewind },
+	[SOURCE_FLASH] = { .name = "flash", .open = flash_open, .read = flash_read },
+	[SOURCE_BUFFER] = { .name = "buffer", .open = buffer_open, .read = buffer_read },
+};
+
+int source_select(enum source_type type)
+{
+	int err;
+
+	if (type >= SOURCE_COUNT) {
+		return -EINVAL;
+	}
+
+	if (sources[type].open) {
+		err = sources[type].open();
+		if (err) {
+			return err;
+		}
+	}
+
+	selected = type;
+
+	return 0;
+}
+
+enum source_type source_selected(void)
+{
+	return selected;
+}
+
+const char *source_name(enum source_type type)
+{
+	return type < SOURCE_COUNT ? sources[type].name : "unknown";
+}
+
+int source_rewind(void)
+{
+	offset = 0;
+
+	if (sources[selected].open) {
+		int err = sources[selected].open();
+
+		if (err) {
+			return err;
+		}
+	}
+
+	return sources[selected].rewind ? sources[selected].rewind() : 0;
+}
+
+int source_fill(struct net_buf *buf)
+{
+	int err;
+
+	if (!sources[selected].read) {
+		return 0;
+	}
+
+	err = sources[selected].read(buf->data, buf->len, offset);
+	offset += buf->len;
+
+	return err;
+}
+
+int source_buffer_append(const uint8_t *data, size_t len)
+{
+	if (len > sizeof(buffer) - buffer_len) {
+		return -ENOMEM;
+	}
+
+	memcpy(&buffer[buffer_len], data, len);
+	buffer_len += len;
+
+	return 0;
+}
+
+void source_buffer_clear(void)
+{
+	buffer_len = 0;
+
+	if (selected == SOURCE_BUFFER) {
+		selected = SOURCE_PATTERN;
+	}
+}
+
+size_t source_buffer_len(void)
+{
+	return buffer_len;
+}
+
+size_t source_flash_size(void)
+{
+#if defined(SOURCE_FLASH_ID)
+	return FIXED_PARTITION_SIZE(storage_partition);
+#else
+	return 0;
+#endif
+}
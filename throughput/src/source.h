@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_SOURCE_H_
+#define THROUGHPUT_SOURCE_H_
+
+#include <stddef.h>
+#include <zephyr/types.h>
+#include <zephyr/net/buf.h>
+
+/** Where the test data comes from. */
+enum source_type {
+	/* Generated pattern; the payload ring is filled once, nothing is copied per write */
+	SOURCE_PATTERN = 0,
+	/* Contents of the storage flash partition, repeated */
+	SOURCE_FLASH,
+	/* Data loaded from the shell ('source load'), repeated */
+	SOURCE_BUFFER,
+	SOURCE_COUNT,
+};
+
+/**
+ * @brief Select the data source.
+ *
+ * @retval 0 on success, -ENOTSUP if the board has no storage partition,
+ * -ENODATA if the shell buffer is empty.
+ */
+int source_select(enum source_type type);
+
+/** @brief Selected data source. */
+enum source_type source_selected(void);
+
+/** @brief Name of a data source. */
+const char *source_name(enum source_type type);
+
+/** @brief Start reading from the beginning of the source (start of a run). */
+int source_rewind(void);
+
+/**
+ * @brief Fill a payload buffer with the next buf->len bytes of the source.
+ * Doesn't copy anything for the pattern source.
+ */
+int source_fill(struct net_buf *buf);
+
+/**
+ * @brief Append data to the shell buffer.
+ *
+ * @retval 0 on success, -ENOMEM if the buffer is full.
+ */
+int source_buffer_append(const uint8_t *data, size_t len);
+
+/** @brief Empty the shell buffer. */
+void source_buffer_clear(void);
+
+/** @brief Number of bytes in the shell buffer. */
+size_t source_buffer_len(void);
+
+/** @brief Size of the flash source, 0 if not available. */
+size_t source_flash_size(void);
+
+#endif /* THROUGHPUT_SOURCE_H_ */
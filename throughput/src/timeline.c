@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/shell/shell.h>
+
+#include "timeline.h"
+
+/* Stage n runs from point n to point n + 1; the last entry is the total. */
+#define STAGES (TIMELINE_POINTS - 1)
+
+static const char *const stage_name[STAGES + 1] = {
+	"scan", "connect", "discovery", "ext discovery", "MTU exchange", "total",
+};
+
+struct stage_stats {
+	uint32_t last;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+};
+
+static struct k_spinlock lock;
+static uint64_t stamps[TIMELINE_POINTS];
+/* Next point expected; TIMELINE_POINTS when no cycle is running */
+static enum timeline_point next = TIMELINE_POINTS;
+static uint32_t cycles;
+static struct stage_stats stats[STAGES + 1];
+static K_SEM_DEFINE(ready_sem, 0, 1);
+
+static void stage_add(struct stage_stats *s, uint64_t cyc)
+{
+	uint32_t us = (uint32_t)k_cyc_to_us_floor64(cyc);
+
+	s->last = us;
+	s->min = cycles ? MIN(s->min, us) : us;
+	s->max = MAX(s->max, us);
+	s->sum += us;
+}
+
+void timeline_mark(enum timeline_point point)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (point == TIMELINE_SCAN_START) {
+		next = TIMELINE_SCAN_START;
+	}
+
+	if (point != next) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	stamps[point] = k_cycle_get_64();
+	next = point + 1;
+
+	if (point == TIMELINE_READY) {
+		for (int i = 0; i < STAGES; i++) {
+			stage_add(&stats[i], stamps[i + 1] - stamps[i]);
+		}
+		stage_add(&stats[STAGES], stamps[TIMELINE_READY] - stamps[TIMELINE_SCAN_START]);
+
+		cycles++;
+		next = TIMELINE_POINTS;
+		k_sem_give(&ready_sem);
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void timeline_abort(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	next = TIMELINE_POINTS;
+	k_spin_unlock(&lock, key);
+}
+
+void timeline_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(stats, 0, sizeof(stats));
+	cycles = 0;
+	k_sem_reset(&ready_sem);
+	k_spin_unlock(&lock, key);
+}
+
+int timeline_wait(k_timeout_t timeout)
+{
+	return k_sem_take(&ready_sem, timeout);
+}
+
+void timeline_print(const struct shell *shell)
+{
+	struct stage_stats copy[STAGES + 1];
+	k_spinlock_key_t key;
+	uint32_t count;
+	uint32_t avg;
+
+	key = k_spin_lock(&lock);
+	memcpy(copy, stats, sizeof(copy));
+	count = cycles;
+	k_spin_unlock(&lock, key);
+
+	if (!count) {
+		shell_print(shell, "No connection setup recorded");
+		return;
+	}
+
+	shell_print(shell, "Connection setup over %u cycles (ms)", count);
+	shell_print(shell, "%-14s %10s %10s %10s %10s", "stage", "last", "min", "avg", "max");
+
+	for (int i = 0; i <= STAGES; i++) {
+		avg = (uint32_t)(copy[i].sum / count);
+		shell_print(shell, "%-14s %6u.%03u %6u.%03u %6u.%03u %6u.%03u", stage_name[i],
+			    copy[i].last / 1000, copy[i].last % 1000, copy[i].min / 1000,
+			    copy[i].min % 1000, avg / 1000, avg % 1000, copy[i].max / 1000,
+			    copy[i].max % 1000);
+	}
+}
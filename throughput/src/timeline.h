@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_TIMELINE_H_
+#define THROUGHPUT_TIMELINE_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+/** Points of the connection setup of the central, in order. */
+enum timeline_point {
+	TIMELINE_SCAN_START = 0,
+	TIMELINE_FILTER_MATCH,
+	TIMELINE_CONNECTED,
+	TIMELINE_DISCOVERED,
+	TIMELINE_MTU_EXCHANGE,
+	TIMELINE_READY,
+	TIMELINE_POINTS,
+};
+
+/**
+ * @brief Record a point of the setup. TIMELINE_SCAN_START starts a cycle and
+ * TIMELINE_READY ends it; points out of order are ignored.
+ */
+void timeline_mark(enum timeline_point point);
+
+/** @brief Drop the current cycle (connection failed or lost during setup). */
+void timeline_abort(void);
+
+/** @brief Clear the statistics. */
+void timeline_reset(void);
+
+/** @brief Wait until a cycle ends. */
+int timeline_wait(k_timeout_t timeout);
+
+/** @brief Print the last, min, average and max time of every stage. */
+void timeline_print(const struct shell *shell);
+
+#endif /* THROUGHPUT_TIMELINE_H_ */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "tx_engine.h"
+
+static void tx_done(struct bt_conn *conn, void *user_data)
+{
+	struct net_buf *buf = user_data;
+	struct tx_window *win = *(struct tx_window **)net_buf_user_data(buf);
+	uint16_t len = buf->len;
+
+	ARG_UNUSED(conn);
+
+	/* Reclaim the buffer before the credit so the sender never waits on the ring. */
+	net_buf_unref(buf);
+	tx_window_complete(win, len);
+}
+
+void tx_window_init(struct tx_window *win, uint8_t size)
+{
+	win->size = CLAMP(size, 1, TX_WINDOW_SIZE);
+	win->kick = NULL;
+	k_sem_init(&win->credits, win->size, win->size);
+	atomic_set(&win->sent, 0);
+	atomic_set(&win->acked, 0);
+}
+
+int tx_window_acquire(struct tx_window *win, k_timeout_t timeout)
+{
+	return k_sem_take(&win->credits, timeout);
+}
+
+void tx_window_complete(struct tx_window *win, uint16_t len)
+{
+	atomic_add(&win->acked, len);
+	k_sem_give(&win->credits);
+
+	if (win->kick) {
+		k_sem_give(win->kick);
+	}
+}
+
+void tx_window_cancel(struct tx_window *win)
+{
+	k_sem_give(&win->credits);
+}
+
+uint8_t tx_window_in_flight(struct tx_window *win)
+{
+	return win->size - k_sem_count_get(&win->credits);
+}
+
+int tx_window_drain(struct tx_window *win, k_timeout_t timeout)
+{
+	k_timepoint_t end = sys_timepoint_calc(timeout);
+	int taken = 0;
+	int err = 0;
+
+	/* Holding every credit means nothing is left in the stack. */
+	while (taken < win->size) {
+		err = k_sem_take(&win->credits, sys_timepoint_timeout(end));
+		if (err) {
+			break;
+		}
+		taken++;
+	}
+
+	while (taken--) {
+		k_sem_give(&win->credits);
+	}
+
+	return err;
+}
+
+int tx_engine_write_handle(struct tx_window *win, struct bt_conn *conn, uint16_t handle,
+			   struct net_buf *buf, k_timeout_t timeout)
+{
+	uint16_t len = buf->len;
+	int err;
+
+	err = tx_window_acquire(win, timeout);
+	if (err) {
+		net_buf_unref(buf);
+		return err;
+	}
+
+	*(struct tx_window **)net_buf_user_data(buf) = win;
+
+	/* The GATT client API takes a pointer, not a buffer. The payload is referenced
+	 * from the ring rather than staged in a separate buffer, and the ring entry is
+	 * held until the TX complete callback.
+	 */
+	err = bt_gatt_write_without_response_cb(conn, handle, buf->data, len, false, tx_done, buf);
+	if (err) {
+		net_buf_unref(buf);
+		tx_window_cancel(win);
+		return err;
+	}
+
+	tx_window_submitted(win, len);
+
+	return 0;
+}
+
+int tx_engine_write(struct tx_window *win, struct bt_throughput *throughput,
+		    struct net_buf *buf, k_timeout_t timeout)
+{
+	return tx_engine_write_handle(win, throughput->conn, throughput->char_handle, buf,
+				      timeout);
+}
+
+int tx_engine_notify(struct tx_window *win, struct bt_conn *conn,
+		     const struct bt_gatt_attr *attr, struct net_buf *buf, k_timeout_t timeout)
+{
+	struct bt_gatt_notify_params params = {
+		.attr = attr,
+		.data = buf->data,
+		.len = buf->len,
+		.func = tx_done,
+		.user_data = buf,
+	};
+	uint16_t len = buf->len;
+	int err;
+
+	err = tx_window_acquire(win, timeout);
+	if (err) {
+		net_buf_unref(buf);
+		return err;
+	}
+
+	*(struct tx_window **)net_buf_user_data(buf) = win;
+
+	err = bt_gatt_notify_cb(conn, &params);
+	if (err) {
+		net_buf_unref(buf);
+		tx_window_cancel(win);
+		return err;
+	}
+
+	tx_window_submitted(win, len);
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 Ezurio
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef THROUGHPUT_TX_ENGINE_H_
+#define THROUGHPUT_TX_ENGINE_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <bluetooth/services/throughput.h>
+
+/* The stack can't hold more PDUs than it has connection TX contexts or ACL buffers.
+ * One of each is left for ATT requests (metrics read) issued while streaming.
+ */
+#if defined(CONFIG_BT_CONN_TX_MAX)
+#define TX_STACK_LIMIT MIN(CONFIG_BT_CONN_TX_MAX, CONFIG_BT_BUF_ACL_TX_COUNT)
+#else
+#define TX_STACK_LIMIT CONFIG_BT_BUF_ACL_TX_COUNT
+#endif
+
+#define TX_WINDOW_SIZE MAX(1, MIN(CONFIG_BT_THROUGHPUT_TX_WINDOW, TX_STACK_LIMIT - 1))
+
+/** A window of writes that are outstanding in the stack.
+ * Credits are taken before each submission and returned by the TX complete callback.
+ */
+struct tx_window {
+	struct k_sem credits;
+	uint8_t size;
+	/* Optionally given on each completion (scheduler waiting for any window) */
+	struct k_sem *kick;
+	atomic_t sent;
+	atomic_t acked;
+};
+
+/**
+ * @brief Reset the window and its byte counters before a run.
+ * Must not be called while writes are in flight.
+ *
+ * @param win  Window.
+ * @param size Number of credits (at most TX_WINDOW_SIZE).
+ */
+void tx_window_init(struct tx_window *win, uint8_t size);
+
+/** @brief Number of credits currently available. */
+static inline uint8_t tx_window_credits(struct tx_window *win)
+{
+	return k_sem_count_get(&win->credits);
+}
+
+/**
+ * @brief Wait until every outstanding write has completed.
+ *
+ * @retval 0 when the window is empty, -EAGAIN on timeout.
+ */
+int tx_window_drain(struct tx_window *win, k_timeout_t timeout);
+
+/** @brief Number of writes currently outstanding in the stack. */
+uint8_t tx_window_in_flight(struct tx_window *win);
+
+/**
+ * @brief Take a credit for one transmission.
+ *
+ * @retval 0 on success, -EAGAIN if no credit was returned in time.
+ */
+int tx_window_acquire(struct tx_window *win, k_timeout_t timeout);
+
+/** @brief Return a credit after the stack has sent len bytes. */
+void tx_window_complete(struct tx_window *win, uint16_t len);
+
+/** @brief Return a credit when a submission failed. */
+void tx_window_cancel(struct tx_window *win);
+
+/** @brief Account len bytes as submitted. */
+static inline void tx_window_submitted(struct tx_window *win, uint16_t len)
+{
+	atomic_add(&win->sent, len);
+}
+
+/**
+ * @brief Queue a write without response to the throughput characteristic.
+ * Blocks until a credit is available, so the stack always has
+ * TX_WINDOW_SIZE writes queued while the sender is ahead of the radio.
+ *
+ * @param win        Window tracking the outstanding writes.
+ * @param throughput Throughput service instance with discovered handles.
+ * @param buf        Payload from the payload ring. The reference is always consumed;
+ *                   the buffer returns to the ring when the write has been sent.
+ * @param timeout    Maximum time to wait for a credit.
+ *
+ * @retval 0 on success, -EAGAIN if no credit was returned in time,
+ * otherwise error from the GATT client.
+ */
+int tx_engine_write(struct tx_window *win, struct bt_throughput *throughput,
+		    struct net_buf *buf, k_timeout_t timeout);
+
+/**
+ * @brief Queue a write without response to any characteristic value handle.
+ * Same credit handling as tx_engine_write().
+ */
+int tx_engine_write_handle(struct tx_window *win, struct bt_conn *conn, uint16_t handle,
+			   struct net_buf *buf, k_timeout_t timeout);
+
+/**
+ * @brief Queue a notification of a characteristic value.
+ * Same credit handling as tx_engine_write().
+ *
+ * @param win     Window tracking the outstanding notifications.
+ * @param conn    Connection of the subscriber.
+ * @param attr    Characteristic value attribute.
+ * @param buf     Payload from the payload ring. The reference is always consumed.
+ * @param timeout Maximum time to wait for a credit.
+ */
+int tx_engine_notify(struct tx_window *win, struct bt_conn *conn,
+		     const struct bt_gatt_attr *attr, struct net_buf *buf, k_timeout_t timeout);
+
+#endif /* THROUGHPUT_TX_ENGINE_H_ */
@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+# Copyright (c) 2024 Ezurio
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Run the throughput sample in BabbleSim.
+# Build both images first with twister, e.g.:
+#   west twister -T . -p nrf52_bsim
+# The central fails when the rate is below CONFIG_BT_THROUGHPUT_AUTORUN_MIN_KBPS.
+
+source ${ZEPHYR_BASE}/tests/bsim/sh_common.source
+
+simulation_id="throughput"
+verbosity_level=2
+# 60 s of simulated time
+sim_length=60e6
+
+cd ${BSIM_OUT_PATH}/bin
+
+Execute ./bs_${BOARD_TS:-nrf52_bsim}_samples_bluetooth_throughput_central \
+  -v=${verbosity_level} -s=${simulation_id} -d=0 -RealEncryption=0
+
+Execute ./bs_${BOARD_TS:-nrf52_bsim}_samples_bluetooth_throughput_peripheral \
+  -v=${verbosity_level} -s=${simulation_id} -d=1 -RealEncryption=0
+
+Execute ./bs_2G4_phy_v1 -v=${verbosity_level} -s=${simulation_id} \
+  -D=2 -sim_length=${sim_length} $@
+
+wait_for_background_jobs